@@ -1,11 +1,10 @@
 #include "apu.h"
 #include "../cpu6502.h"
+#include "../machine.h"
 
-#define TND_LUT_SIZE   203
-#define PULSE_LUT_SIZE 31
 #define AUDIO_TO_FILE  0
 
-static uint8_t duty[4][8] =
+static const uint8_t duty[4][8] =
 {
 	{0, 1, 0, 0, 0, 0, 0, 0}, // 12.5 %
 	{0, 1, 1, 0, 0, 0, 0, 0}, // 25 %
@@ -13,112 +12,153 @@ static uint8_t duty[4][8] =
 	{1, 0, 0, 1, 1, 1, 1, 1}  // 25 % negated
 };
 
+// The mixer's output for a sum of pulse channel outputs (at most 30),
+// and of triangle, noise and DMC outputs (at most 202). The tables are
+// constant expressions, so that every APU shares them read-only.
+#define PULSE_MIX(i) ((i) ? 95.52f / (8128.0f / (i) + 100) : 0)
+#define TND_MIX(i)   ((i) ? 163.67f / (24329.0f / (i) + 100) : 0)
 
-static float tnd_lut[TND_LUT_SIZE];
-static float pulse_lut[PULSE_LUT_SIZE];
+#define MIX4(f, i)  f(i), f((i) + 1), f((i) + 2), f((i) + 3)
+#define MIX16(f, i) MIX4(f, i), MIX4(f, (i) + 4), MIX4(f, (i) + 8), MIX4(f, (i) + 12)
+#define MIX64(f, i) MIX16(f, i), MIX16(f, (i) + 16), MIX16(f, (i) + 32), MIX16(f, (i) + 48)
 
-static void compute_mixer_lut()
+static const float pulse_lut[32] =
 {
-	pulse_lut[0] = 0;
-	for (int i = 1; i < PULSE_LUT_SIZE; i++)
-		pulse_lut[i] = 95.52f / (8128.0f / (float) i + 100);
-
-	tnd_lut[0] = 0;
-	for (int i = 1; i < TND_LUT_SIZE; i++)
-		tnd_lut[i] = 163.67f / (24329.0f / (float) i + 100);
-}
+	MIX16(PULSE_MIX, 0), MIX16(PULSE_MIX, 16)
+};
 
-static void sampler_init(apu_t* apu, int frequency)
+static const float tnd_lut[256] =
 {
-	float cycles_per_frame = apu->bus->mapper->type == PAL? 33247.5: 29780.5;
-	float rate = apu->bus->mapper->type == PAL? 50.0f : 60.0f;
-	sampler_t* sampler = &apu->sampler;
-
-	// Q = 0.707 => BW = 1.414 (1 octave)
-	apu->filter = biquad_create(HPF, 0, 20, frequency, 1);
-
-	// Anti-aliasing filter.
-	apu->aa_filter = biquad_create(LPF, 0, 20000, cycles_per_frame * rate, 1);
+	MIX64(TND_MIX, 0), MIX64(TND_MIX, 64), MIX64(TND_MIX, 128), MIX64(TND_MIX, 192)
+};
 
-	sampler->max_period   = cycles_per_frame * rate / frequency;
-	sampler->min_period   = sampler->max_period - 1;
-	sampler->period       = sampler->min_period;
-	sampler->index        = 0;
-	sampler->max_index    = AUDIO_BUFF_SIZE;
+static void sampler_init(apu_output_t* out, enum tv_system type, int frequency)
+{
+	float cycles_per_frame = type == PAL? 33247.5: 29780.5;
+	float rate = type == PAL? 50.0f : 60.0f;
+	sampler_t* sampler = &out->sampler;
+	double nominal = cycles_per_frame * rate / frequency;
+
+	// The NES's output stages: two high-pass filters (90 Hz and
+	// 440 Hz) and a 14 kHz low-pass filter.
+	memset(&out->filters, 0, sizeof(out->filters));
+	filter_chain_add(&out->filters, filter_create(FILTER_HIGH_PASS, 90, frequency));
+	filter_chain_add(&out->filters, filter_create(FILTER_HIGH_PASS, 440, frequency));
+	filter_chain_add(&out->filters, filter_create(FILTER_LOW_PASS, 14000, frequency));
+	out->block_len = 0;
+
+	sampler->max_period   = nominal * (1 + SAMPLER_RATE_RANGE);
+	sampler->min_period   = nominal * (1 - SAMPLER_RATE_RANGE);
 	sampler->samples      = 0;
-	sampler->counter      = 0;
-	sampler->factor_index = 0;
+	sampler->steps        = 0;
 
 	// basically the precision with which we vary the
 	// sampling rate. 100 ->2 d.p, 1000->3 d.p, etc.
 	sampler->max_factor = 100;
 
-	// This may need to be calibrated to suit the current
-	// sampling frequency; the current equilibrium is
-	// for 48000 hz.
-	sampler->target_factor = sampler->equilibrium_factor = 48;
+	// The period is interpolated between min_period and max_period
+	// by target_factor / max_factor, so the equilibrium is midway.
+	sampler->target_factor = sampler->equilibrium_factor = 50;
+	sampler->period = nominal;
+
+}
+
+int apu_quality_width(enum audio_quality quality)
+{
+	static const int widths[] = {
+		[AUDIO_OFF]    = 0,
+		[AUDIO_LINEAR] = 2,
+		[AUDIO_SINC8]  = 8,
+		[AUDIO_SINC16] = 16,
+		[AUDIO_SINC32] = 32
+	};
+	if ((unsigned)quality >= sizeof(widths) / sizeof(widths[0]))
+		return -1;
+	return widths[quality];
 }
 
-static void init_audio_device(const apu_t* apu)
+// set_quality switches out to the given quality level. It returns -1,
+// leaving out as it was, if the level is unknown or its kernel cannot
+// be allocated.
+static int set_quality(apu_output_t* out, enum audio_quality quality)
 {
-	SDL_AudioSpec want;
-	SDL_zero(want);
+	int width = apu_quality_width(quality);
+	if (width < 0) {
+		LOG(ERROR, "Unknown audio quality %d", quality);
+		return -1;
+	}
 
-	// Set the audio format.
-	want.freq   = SAMPLING_FREQUENCY;
-	want.format = AUDIO_S16SYS;
+	float* kernel = NULL;
+	if (quality != AUDIO_OFF && !(kernel = blip_kernel_create(width)))
+		return -1;
 
-	want.channels = 1;
-	want.callback = NULL;
-	want.userdata = NULL;
-	want.silence  = 0;
+	blip_kernel_destroy(out->blip_kernel);
+	out->blip_kernel = kernel;
+	out->quality     = quality;
 
-	apu->gfx->audio_device = SDL_OpenAudioDevice(NULL, 0, &want, NULL, 0);
-	if (apu->gfx->audio_device == 0) {
-		LOG(ERROR , SDL_GetError());
-		exit(EXIT_FAILURE);
-	}
+	out->blip        = blip_create(out->blip_kernel, width, out->sampler.period);
+	out->amplitude   = 0;
+	out->blip_clocks = 0;
+	out->block_len   = 0;
+	return 0;
 }
 
-apu_t* apu_create(bus_t* bus, gfx_t* gfx)
-{
-	compute_mixer_lut();
+int apu_set_quality(apu_t* apu, enum audio_quality quality)
+{ return set_quality(apu_output(apu), quality); }
 
-	apu_t* apu = malloc(sizeof(apu_t));
-	memset(apu, 0, sizeof(apu_t));
+void apu_mute(apu_t* apu, uint8_t muted)
+{ apu_output(apu)->muted = muted; }
 
-	apu->volume          = 1;
-	apu->bus             = bus;
-	apu->gfx             = gfx;
-	apu->cycles          = 0;
-	apu->sequencer       = 0;
-	apu->reset_sequencer = 0;
-	apu->audio_start     = 0;
-	apu->IRQ_inhibit     = 0;
-
-	// For keeping track of queue_size statistics for use by
-	// the adaptive sampler.
-	memset(apu->stat_window, 0, sizeof(apu->stat_window));
-	apu->stat_index = 0;
-	apu->stat       = 0;
+// silent reports whether the mixer output is not being synthesized.
+static inline uint8_t silent(const apu_output_t* out)
+{ return out->quality == AUDIO_OFF || out->muted; }
 
+void apu_init(apu_t* apu)
+{
+	memset(apu, 0, sizeof(apu_t));
 	apu->pulse1 = pulse_create(1);
 	apu->pulse2 = pulse_create(2);
 	apu->tri    = triangle_create();
 	apu->noise  = noise_create();
 	apu->dmc    = dmc_create();
 
-	sampler_init(apu, SAMPLING_FREQUENCY);
-	init_audio_device(apu);
-	SDL_PauseAudioDevice(gfx->audio_device, 1);
 	apu_set_status(apu, 0);
 	apu_set_frame_counter_ctrl(apu, 0);
+}
 
-	return apu;
+int apu_output_init(apu_output_t* out, enum tv_system type)
+{
+	memset(out, 0, sizeof(apu_output_t));
+	out->volume = 1;
+
+	if (!(out->ring = ring_create()))
+		return -1;
+
+	out->block = malloc(sizeof(float) * AUDIO_BLOCK_SIZE);
+	out->frame = malloc(sizeof(int16_t) * AUDIO_FRAME_SIZE);
+	if (!out->block || !out->frame) {
+		LOG(ERROR, "Failed to allocate audio block");
+		ring_destroy(out->ring);
+		free(out->block);
+		free(out->frame);
+		return -1;
+	}
+
+	sampler_init(out, type, SAMPLING_FREQUENCY);
+	if (set_quality(out, AUDIO_DEFAULT_QUALITY)) {
+		apu_output_free(out);
+		return -1;
+	}
+	return 0;
 }
 
-void apu_destroy(apu_t* apu)
-{ free(apu); }
+void apu_output_free(apu_output_t* out)
+{
+	ring_destroy(out->ring);
+	blip_kernel_destroy(out->blip_kernel);
+	free(out->block);
+	free(out->frame);
+}
 
 void apu_reset(apu_t* apu)
 {
@@ -161,28 +201,73 @@ void half_frame(apu_t* apu)
 		noise->l--;
 }
 
-void sample(apu_t* apu)
+// to_sample scales a filtered sample to 16 bits.
+static inline int16_t to_sample(float val, float scale)
+{
+	val *= scale;
+	return val > INT16_MAX ? INT16_MAX : val < INT16_MIN ? INT16_MIN : val;
+}
+
+// process_block runs the filter chain over the collected samples, and
+// moves them, scaled, into the audio ring, or the frame once samples
+// are taken by apu_take_audio.
+static void process_block(apu_output_t* out)
 {
-	float sample = biquad_apply(&apu->aa_filter, apu_get_sample(apu));
-	sampler_t* sampler = &apu->sampler;
-	sampler->counter++;
-	if (sampler->counter < sampler->period)
+	filter_chain_apply(&out->filters, out->block, out->block_len);
+
+	float scale = 32000 * out->volume;
+	if (!out->take) {
+		for (size_t i = 0; i < out->block_len; i++)
+			ring_write(out->ring, to_sample(out->block[i], scale));
+		out->block_len = 0;
 		return;
+	}
 
-	apu->buff[sampler->index++] = 32000 * biquad_apply(&apu->filter, sample) * apu->volume;
-	if(sampler->index >= sampler->max_index) {
-		sampler->index = 0;
+	if (out->frame_taken) {
+		out->frame_len = 0;
+		out->frame_taken = 0;
 	}
 
-	sampler->samples++;
-	sampler->counter = 0;
+	size_t room = AUDIO_FRAME_SIZE - out->frame_len;
+	size_t len = (out->block_len < room) ? out->block_len : room;
+	for (size_t i = 0; i < len; i++)
+		out->frame[out->frame_len + i] = to_sample(out->block[i], scale);
+	out->frame_len += len;
+	out->block_len = 0;
+}
+
+// read_samples ends the band-limited step buffer's frame and appends
+// its samples to the block.
+static void read_samples(apu_output_t* out)
+{
+	blip_end_frame(&out->blip, out->blip_clocks);
+	out->blip_clocks = 0;
+
+	if (out->block_len + BLIP_BUFF_SIZE > AUDIO_BLOCK_SIZE)
+		process_block(out);
+
+	size_t count = blip_read_samples(&out->blip,
+		out->block + out->block_len, BLIP_BUFF_SIZE);
+
+	out->block_len += count;
+	out->sampler.samples += count;
+}
+
+void sample(apu_t* apu)
+{
+	apu_output_t* out = apu_output(apu);
+	if (silent(out))
+		return;
 
-	sampler->period = (apu->sampler.factor_index <= apu->sampler.target_factor) ?
-		sampler->max_period : sampler->min_period;
+	float amplitude = apu_get_sample(apu);
+	if (amplitude != out->amplitude) {
+		blip_add_delta(&out->blip, out->blip_clocks, amplitude - out->amplitude);
+		out->amplitude = amplitude;
+		out->sampler.steps++;
+	}
 
-	sampler->factor_index++;
-	if(sampler->factor_index > sampler->max_factor)
-		sampler->factor_index = 0;
+	if (++out->blip_clocks >= BLIP_FLUSH_CLOCKS)
+		read_samples(out);
 }
 
 void clock_dmc(apu_t* apu)
@@ -191,8 +276,8 @@ void clock_dmc(apu_t* apu)
 
 	if (dmc->enabled && dmc->empty) {
 		if(dmc->bytes_remaining > 0) {
-			apu->bus->cpu->dma_cycles += 3;
-			dmc->sample = bus_read(apu->bus, dmc->current_addr);
+			apu_bus(apu)->cpu->dma_cycles += 3;
+			dmc->sample = bus_read(apu_bus(apu), dmc->current_addr);
 			dmc->empty = 0;
 			dmc->bytes_remaining--;
 			if(dmc->current_addr == 0xffff)
@@ -208,7 +293,7 @@ void clock_dmc(apu_t* apu)
 			}else if(dmc->irq_enable && !dmc->irq_set) {
 				dmc->interrupt = 1;
 				dmc->irq_set = 1;
-				cpu_interrupt(apu->bus->cpu, IRQ);
+				cpu_interrupt(apu_bus(apu)->cpu, IRQ);
 			}
 		}
 	}
@@ -257,7 +342,7 @@ void apu_exec(apu_t* apu)
 		goto post_sequencer;
 	}
 
-	switch (apu->bus->mapper->type) {
+	switch (apu_bus(apu)->mapper->type) {
 	case NTSC:
 	default:
 		switch (apu->sequencer) {
@@ -290,7 +375,7 @@ void apu_exec(apu_t* apu)
 			half_frame(apu);
 			if (!apu->IRQ_inhibit) {
 				apu->frame_interrupt = 1;
-				cpu_interrupt(apu->bus->cpu, IRQ);
+				cpu_interrupt(apu_bus(apu)->cpu, IRQ);
 			}
 			apu->sequencer = 0;
 			break;
@@ -335,7 +420,7 @@ void apu_exec(apu_t* apu)
 
 			if (!apu->IRQ_inhibit) {
 				apu->frame_interrupt = 1;
-				cpu_interrupt(apu->bus->cpu, IRQ);
+				cpu_interrupt(apu_bus(apu)->cpu, IRQ);
 			}
 			apu->sequencer = 0;
 			break;
@@ -358,14 +443,8 @@ post_sequencer:
 		divider_clock(&apu->pulse2.t);
 
 		// noise timer
-		if (divider_clock(&apu->noise.timer)) {
-			noise_t* noise = &apu->noise;
-			uint8_t feedback = (noise->shift & BIT_0) ^
-				(((noise->mode ? BIT_6 : BIT_1) & noise->shift) > 0);
-
-			noise->shift >>= 1;
-			noise->shift |= feedback ? (1 << 14) : 0;
-		}
+		if (divider_clock(&apu->noise.timer))
+			noise_shift(&apu->noise);
 	}
 
 	// DMC
@@ -380,45 +459,215 @@ post_sequencer:
 	apu->cycles++;
 }
 
-void apu_queue_audio(apu_t* apu, gfx_t* gfx)
+// Frame sequencer steps at which apu_exec does more than count.
+static const size_t sequencer_steps_ntsc[] = {7457, 14913, 22371, 29829, 37281};
+static const size_t sequencer_steps_pal[]  = {8313, 16627, 24939, 33253, 41565};
+
+static inline size_t earliest(size_t a, size_t b)
+{ return (a < b) ? a : b; }
+
+static inline uint8_t dmc_silent(dmc_t* dmc)
+{ return dmc->silence && dmc->empty; }
+
+// pulse_audible returns whether the pulse's timer output can change
+// the mixer output before the next frame sequencer step.
+static uint8_t pulse_audible(pulse_t* pulse)
 {
-	uint32_t queue_size = SDL_GetQueuedAudioSize(gfx->audio_device);
-	apu->stat = apu->stat - apu->stat_window[apu->stat_index] + queue_size;
-	apu->stat_window[apu->stat_index++] = queue_size;
-	if(apu->stat_index >= STATS_WIN_SIZE)
-		apu->stat_index = 0;
+	uint8_t volume = pulse->const_volume ?
+		pulse->envelope.period : pulse->envelope.step;
+	return pulse->enabled && pulse->l && !pulse->mute && volume;
+}
 
-	size_t avg = apu->stat / STATS_WIN_SIZE;
+// quiet_cycles returns the number of cycles, starting with the next
+// one, in which apu_exec would only count down the sequencer and
+// timers, and clock timers whose output is inaudible.
+static size_t quiet_cycles(apu_t* apu)
+{
+	if (apu->reset_sequencer)
+		return 0;
+
+	// The DMC must have nothing to fetch, reload or interrupt for. It
+	// is played back a bit per tick of its rate timer, unless silent.
+	dmc_t* dmc = &apu->dmc;
+	if (dmc->enabled && dmc->empty && (dmc->bytes_remaining ||
+			dmc->loop || (dmc->irq_enable && !dmc->irq_set)))
+		return 0;
+	size_t span = dmc_silent(dmc) ? SIZE_MAX : dmc->rate_index;
+
+	const size_t* steps = (apu_bus(apu)->mapper->type == PAL) ?
+		sequencer_steps_pal : sequencer_steps_ntsc;
+	for (int i = 0; i < 5; i++) {
+		if (apu->sequencer <= steps[i]) {
+			span = earliest(span, steps[i] - apu->sequencer);
+			break;
+		}
+	}
+
+	apu_output_t* out = apu_output(apu);
+	if (silent(out))
+		return span;
+
+	// A change in amplitude, made by a register write, is due now.
+	if (apu_get_sample(apu) != out->amplitude)
+		return 0;
+	span = earliest(span, BLIP_FLUSH_CLOCKS - out->blip_clocks);
+
+	// The pulse and noise timers are clocked on odd cycles, and
+	// trigger once their counter is 0.
+	size_t odd = !(apu->cycles & 1);
+	if (pulse_audible(&apu->pulse1))
+		span = earliest(span, odd + 2 * (size_t)apu->pulse1.t.counter);
+	if (pulse_audible(&apu->pulse2))
+		span = earliest(span, odd + 2 * (size_t)apu->pulse2.t.counter);
+
+	noise_t* noise = &apu->noise;
+	uint8_t volume = noise->const_volume ? noise->envelope.period : noise->envelope.step;
+	if (noise->enabled && noise->l && volume)
+		span = earliest(span, odd + 2 * (size_t)noise->timer.counter);
+
+	triangle_t* tri = &apu->tri;
+	if (tri->enabled && tri->sequencer.period > 1 && tri->length_counter && tri->linear_counter)
+		span = earliest(span, (size_t)tri->sequencer.counter);
+
+	return span;
+}
+
+// skip_cycles runs the given number of quiet cycles (see quiet_cycles)
+// at once.
+static void skip_cycles(apu_t* apu, size_t cycles)
+{
+	size_t odd = (cycles + (apu->cycles & 1)) / 2;
+	divider_advance(&apu->pulse1.t, odd);
+	divider_advance(&apu->pulse2.t, odd);
+	for (size_t n = divider_advance(&apu->noise.timer, odd); n; n--)
+		noise_shift(&apu->noise);
+
+	triangle_advance(&apu->tri, cycles);
+	if (dmc_silent(&apu->dmc))
+		dmc_advance_silent(&apu->dmc, cycles);
+	else
+		apu->dmc.rate_index -= cycles;
+	apu->sequencer += cycles;
+	apu->cycles += cycles;
+
+	apu_output_t* out = apu_output(apu);
+	if (silent(out))
+		return;
+
+	out->blip_clocks += cycles;
+	if (out->blip_clocks >= BLIP_FLUSH_CLOCKS)
+		read_samples(out);
+}
+
+void apu_run(apu_t* apu, size_t cycles)
+{
+	while (cycles) {
+		size_t span = earliest(quiet_cycles(apu), cycles);
+		if (!span) {
+			apu_exec(apu);
+			cycles--;
+			continue;
+		}
+		skip_cycles(apu, span);
+		cycles -= span;
+	}
+}
+
+void apu_sync(apu_t* apu, size_t cycle)
+{
+	if (cycle > apu->cycles)
+		apu_run(apu, cycle - apu->cycles);
+}
+
+size_t apu_next_event(apu_t* apu)
+{
+	size_t next = SIZE_MAX;
+
+	// The sequencer restarts on the next cycle.
+	if (apu->reset_sequencer)
+		return 1;
+
+	// Frame IRQ at the end of the 4-step sequence.
+	if (!apu->frame_mode && !apu->IRQ_inhibit) {
+		size_t irq = (apu_bus(apu)->mapper->type == PAL) ? 33253 : 29829;
+		if (apu->sequencer <= irq)
+			next = irq - apu->sequencer + 1;
+	}
+
+	// The DMC fetches samples (stalling the CPU), reloads or raises
+	// an IRQ once its sample buffer is empty, and the buffer is only
+	// emptied on a rate timer tick.
+	dmc_t* dmc = &apu->dmc;
+	if (dmc->enabled && (dmc->bytes_remaining || dmc->loop ||
+			     (dmc->irq_enable && !dmc->irq_set))) {
+		size_t fetch = dmc->empty ? 1 : (size_t)dmc->rate_index + 1;
+		next = (fetch < next) ? fetch : next;
+	}
+
+	return next;
+}
+
+void apu_queue_audio(apu_t* apu)
+{
+	apu_output_t* out = apu_output(apu);
+	size_t fill = ring_fill(out->ring);
+	out->stat = out->stat - out->stat_window[out->stat_index] + fill;
+	out->stat_window[out->stat_index++] = fill;
+	if(out->stat_index >= STATS_WIN_SIZE)
+		out->stat_index = 0;
+
+	size_t avg = out->stat / STATS_WIN_SIZE;
 
 	// From here we tweak the sampling rate ever so slightly to
 	// prevent underruns and runaway latency by minimising
-	// deviation from the nominal queue size with a bit of
+	// deviation from the nominal ring fill with a bit of
 	// control engineering
-	float delta_f, error = (float)avg - NOMINAL_QUEUE_SIZE;
-	sampler_t* s = &apu->sampler;
+	float delta_f, error = (float)avg - NOMINAL_RING_FILL;
+	sampler_t* s = &out->sampler;
 
 	delta_f = (error >= 0) ?
-		(s->max_factor - s->equilibrium_factor) * error / NOMINAL_QUEUE_SIZE :
-		(s->equilibrium_factor * error / NOMINAL_QUEUE_SIZE);
+		(s->max_factor - s->equilibrium_factor) * error / NOMINAL_RING_FILL :
+		(s->equilibrium_factor * error / NOMINAL_RING_FILL);
 
 	s->target_factor = s->equilibrium_factor + delta_f;
 	if(s->target_factor > s->max_factor)
 		s->target_factor = s->max_factor;
 
-	SDL_QueueAudio(gfx->audio_device, apu->buff, s->index * 2);
+	read_samples(out);
+	process_block(out);
+	s->period = s->min_period +
+		(s->max_period - s->min_period) * s->target_factor / s->max_factor;
+	blip_set_period(&out->blip, s->period);
 
-	// wait till queue is filled to prevent early onset underruns
-	if(!apu->audio_start && queue_size >= NOMINAL_QUEUE_SIZE) {
-		SDL_PauseAudioDevice(apu->gfx->audio_device, 0);
-		apu->audio_start = 1;
-	}
+	ring_publish(out->ring);
+}
 
-	memset(apu->buff, 0, AUDIO_BUFF_SIZE * 2);
+void apu_discard_audio(apu_t* apu)
+{
+	apu_output_t* out = apu_output(apu);
+	read_samples(out);
+	out->block_len = 0;
+	out->frame_len = 0;
+	ring_discard(out->ring);
+}
+
+const int16_t* apu_take_audio(apu_t* apu, size_t* count)
+{
+	apu_output_t* out = apu_output(apu);
+	if (!out->take) {
+		ring_discard(out->ring);
+		out->take = 1;
+	}
 
-	// reset sampler
-	s->index = 0;
+	read_samples(out);
+	process_block(out);
+	out->frame_taken = 1;
+	*count = out->frame_len;
+	return out->frame;
 }
 
+double apu_audio_latency(apu_t* apu)
+{ return ring_latency(apu_output(apu)->ring) * 1000 / SAMPLING_FREQUENCY; }
 
 float apu_get_sample(apu_t* apu)
 {
@@ -504,3 +753,44 @@ void apu_set_frame_counter_ctrl(apu_t* apu, uint8_t value)
 
 	apu->reset_sequencer = 1;
 }
+
+#define APU_STATE_VERSION 1
+
+void apu_save(apu_t* apu, state_t* state)
+{
+	state_begin(state, "APU ", APU_STATE_VERSION);
+	pulse_save(&apu->pulse1, state);
+	pulse_save(&apu->pulse2, state);
+	triangle_save(&apu->tri, state);
+	noise_save(&apu->noise, state);
+	dmc_save(&apu->dmc, state);
+	state_write_u8(state, apu->frame_mode);
+	state_write_u8(state, apu->status);
+	state_write_u8(state, apu->IRQ_inhibit);
+	state_write_u8(state, apu->frame_interrupt);
+	state_write_u8(state, apu->reset_sequencer);
+	state_write_u64(state, apu->cycles);
+	state_write_u32(state, apu->sequencer);
+	state_end(state);
+}
+
+int apu_load(apu_t* apu, state_t* state)
+{
+	if (state_open(state, "APU ", APU_STATE_VERSION) < 0)
+		return -1;
+
+	pulse_load(&apu->pulse1, state);
+	pulse_load(&apu->pulse2, state);
+	triangle_load(&apu->tri, state);
+	noise_load(&apu->noise, state);
+	dmc_load(&apu->dmc, state);
+	apu->frame_mode      = state_read_u8(state);
+	apu->status          = state_read_u8(state);
+	apu->IRQ_inhibit     = state_read_u8(state);
+	apu->frame_interrupt = state_read_u8(state);
+	apu->reset_sequencer = state_read_u8(state);
+	apu->cycles          = state_read_u64(state);
+	apu->sequencer       = state_read_u32(state);
+
+	return state->error ? -1 : 0;
+}
@@ -2,51 +2,105 @@
 #define NES_TOOLS_APU_H
 
 #include "../system.h"
-#include "../gfx.h"
 #include "../bus.h"
 
 #include "audio.h"
+#include "ring.h"
 #include "pulse.h"
-#include "biquad.h"
+#include "filter.h"
+#include "blip.h"
 #include "triangle.h"
 #include "noise.h"
 #include "dmc.h"
 
-// apu_t emulates an NES audio processing unit (APU).
-typedef struct apu_t
+// apu_output_t turns the APU's output into audio: band-limited
+// synthesis of the mixer output, the NES's output filters and the ring
+// an audio device can pull from. It is not part of the machine's state.
+typedef struct
 {
-	bus_t* bus;
-	gfx_t* gfx;
-	float  volume;
+	float volume;
 
-	int16_t buff[AUDIO_BUFF_SIZE];
+	// Samples waiting to be pulled by the audio device, if any.
+	ring_t* ring;
 	size_t  stat_window[STATS_WIN_SIZE];
 
+	sampler_t sampler;
+	float     stat;
+	size_t    stat_index;
+
+	// Output post-processing: samples are collected into block and
+	// filtered a block at a time.
+	filter_chain_t filters;
+	float*         block;
+	size_t         block_len;
+
+	// Band-limited synthesis of the mixer output: the last amplitude,
+	// and the clocks since the buffer was last read.
+	enum audio_quality quality;
+	blip_t   blip;
+	float*   blip_kernel;
+	float    amplitude;
+	uint32_t blip_clocks;
+
+	// Set while the machine runs frames that are not to be heard.
+	uint8_t muted;
+
+	// Set once samples are taken by apu_take_audio instead of being
+	// published to the ring: the samples held, and whether they have
+	// been taken (the next ones replace them).
+	uint8_t  take;
+	int16_t* frame;
+	size_t   frame_len;
+	uint8_t  frame_taken;
+
+} apu_output_t;
+
+// apu_t emulates an NES audio processing unit (APU). Its output goes
+// to the machine's apu_output_t (see apu_output in machine.h).
+typedef struct apu_t
+{
 	pulse_t    pulse1;
 	pulse_t    pulse2;
 	triangle_t tri;
 	noise_t    noise;
 	dmc_t      dmc;
-	sampler_t  sampler;
 
 	uint8_t frame_mode;
 	uint8_t status;
 	uint8_t IRQ_inhibit;
 	uint8_t frame_interrupt;
-	uint8_t audio_start;
 	uint8_t reset_sequencer;
 	size_t  cycles;
 	size_t  sequencer;
-	float   stat;
-	size_t  stat_index;
-
-	biquad_t filter;
-	biquad_t aa_filter;
 
 } apu_t;
 
-apu_t* apu_create(bus_t* bus, gfx_t* gfx);
-void apu_destroy(apu_t* apu);
+// apu_init powers on the APU of a machine (see machine.h), whose bus
+// must already be set up.
+void apu_init(apu_t* apu);
+
+// apu_output_init sets up the audio output for the given TV system.
+// Playing it is up to the caller, which pulls samples from out->ring;
+// otherwise they must be dropped with apu_discard_audio. It returns 0
+// on success, and apu_output_free releases the output.
+int apu_output_init(apu_output_t* out, enum tv_system type);
+void apu_output_free(apu_output_t* out);
+
+// apu_quality_width returns the band-limited step kernel width used
+// at the given quality level, 0 for AUDIO_OFF, or -1 if there is no
+// such level.
+int apu_quality_width(enum audio_quality quality);
+
+// apu_set_quality selects the resampling kernel (see audio_quality).
+// Samples that have not been queued yet are dropped. It returns 0 on
+// success; otherwise the quality is left as it was.
+int apu_set_quality(apu_t* apu, enum audio_quality quality);
+
+// apu_mute stops (or resumes) synthesizing the APU's output. While
+// muted, no samples are produced and the output stages are left as
+// they are, so that frames can be emulated and then undone (see
+// machine_restore) without being heard.
+void apu_mute(apu_t* apu, uint8_t muted);
 
 // apu_reset performs a soft reset on the APU.
 void apu_reset(apu_t* apu);
@@ -54,18 +108,55 @@ void apu_reset(apu_t* apu);
 // apu_exec executes a single APU cycle.
 void apu_exec(apu_t* apu);
 
+// apu_run executes the given number of APU cycles. Stretches in which
+// nothing audible or visible to the CPU happens are skipped in bulk, up
+// to the next frame sequencer step, audible timer reload, DMC tick or
+// band-limited step buffer read.
+void apu_run(apu_t* apu, size_t cycles);
+
+// apu_sync runs the APU until it has caught up with the given cycle.
+void apu_sync(apu_t* apu, size_t cycle);
+
+// apu_next_event returns a lower bound on the number of cycles until
+// the APU next interacts with the CPU (frame IRQ, DMC fetch or DMC
+// IRQ), or SIZE_MAX if no such event is pending.
+size_t apu_next_event(apu_t* apu);
+
 // apu_set_status writes to the APU_STATUS register (0x4015).
 void apu_set_status(apu_t* apu, uint8_t val);
 
 // apu_get_sample cycles the apu_t channels and returns a tone.
 float apu_get_sample(apu_t* apu);
 
-// apu_queue_audio queues audio samples to be played by SDL.
-void apu_queue_audio(apu_t* apu, gfx_t* gfx);
+// apu_queue_audio publishes the samples produced since the last call
+// to the ring, and steers the sampling rate to keep the ring near
+// NOMINAL_RING_FILL.
+void apu_queue_audio(apu_t* apu);
+
+// apu_discard_audio drops the samples produced since the last call
+// to apu_queue_audio or apu_discard_audio.
+void apu_discard_audio(apu_t* apu);
+
+// apu_take_audio returns the samples produced since the last call,
+// and sets count to their number, without copying them. They stay
+// valid until the APU runs again. From the first call on, samples are
+// no longer published to the ring, and the sampling rate is fixed at
+// SAMPLING_FREQUENCY.
+const int16_t* apu_take_audio(apu_t* apu, size_t* count);
+
+// apu_audio_latency returns the average output latency in milliseconds
+// recorded by the audio device (see ring_record_latency).
+double apu_audio_latency(apu_t* apu);
 
 // apu_read_status reads from the APU_STATUS register (0x4015).
 uint8_t apu_read_status(apu_t* apu);
 
 void apu_set_frame_counter_ctrl(apu_t* apu, uint8_t val);
 
+// apu_save writes the APU's state to an "APU " chunk, and apu_load reads
+// it back. apu_load returns 0 on success. Samples that have not been
+// queued yet, and the output stages, are not part of the state.
+void apu_save(apu_t* apu, state_t* state);
+int apu_load(apu_t* apu, state_t* state);
+
 #endif // NES_TOOLS_APU_H
@@ -41,3 +41,54 @@ uint8_t divider_clock_inverse(divider_t* divider)
 	// Trigger clock.
 	return 1;
 }
+
+// advance_step moves a divider's step on by the given number of clocks
+// of its output, as divider_clock would.
+static void advance_step(divider_t* divider, size_t triggers)
+{
+	if (!divider->limit) {
+		divider->step += triggers;
+		return;
+	}
+
+	// The first trigger brings the step back into [from, limit].
+	divider->step++;
+	if (divider->step > divider->limit)
+		divider->step = divider->from;
+
+	uint32_t len = divider->limit - divider->from + 1;
+	divider->step = divider->from + (divider->step - divider->from + triggers - 1) % len;
+}
+
+size_t divider_advance(divider_t* divider, size_t clocks)
+{
+	if (clocks <= (size_t)divider->counter) {
+		divider->counter -= clocks;
+		return 0;
+	}
+
+	// The first trigger takes counter + 1 clocks, then one every
+	// period + 1 clocks.
+	clocks -= divider->counter + 1;
+	size_t triggers = 1 + clocks / (divider->period + 1);
+	divider->counter = divider->period - clocks % (divider->period + 1);
+
+	advance_step(divider, triggers);
+	return triggers;
+}
+
+void divider_save(divider_t* divider, state_t* state)
+{
+	state_write_u32(state, divider->period);
+	state_write_u32(state, divider->counter);
+	state_write_u32(state, divider->step);
+	state_write_u8(state, divider->loop);
+}
+
+void divider_load(divider_t* divider, state_t* state)
+{
+	divider->period  = state_read_u32(state);
+	divider->counter = state_read_u32(state);
+	divider->step    = state_read_u32(state);
+	divider->loop    = state_read_u8(state);
+}
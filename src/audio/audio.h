@@ -3,12 +3,18 @@
 
 #include "../system.h"
 #include "../mapper.h"
+#include "../state.h"
 
 #define SAMPLING_FREQUENCY   48000
-#define AUDIO_BUFF_SIZE      1024
 #define STATS_WIN_SIZE       20
 #define AVERAGE_DOWNSAMPLING 0
-#define NOMINAL_QUEUE_SIZE   6000
+
+// Samples the SDL audio callback pulls at a time.
+#define DEVICE_BUFF_SIZE     512
+
+// Samples the rate control keeps buffered in the audio ring, measured
+// just before each frame's samples are published.
+#define NOMINAL_RING_FILL    1024
 
 enum
 {
@@ -28,19 +34,46 @@ typedef struct
 
 } divider_t;
 
+// Samples may be produced up to this fraction faster or slower than
+// the nominal rate to keep the audio ring near NOMINAL_RING_FILL.
+#define SAMPLER_RATE_RANGE   0.03
+
+// Samples collected before the filter chain runs over them. A frame's
+// samples normally fit in a single block.
+#define AUDIO_BLOCK_SIZE     2048
+
+// Samples held for apu_take_audio between calls; any more are dropped.
+#define AUDIO_FRAME_SIZE     4096
+
+// audio_quality selects the band-limited step kernel the APU's output
+// is resampled with, from cheapest to cleanest. AUDIO_OFF skips audio
+// synthesis altogether.
+enum audio_quality
+{
+	AUDIO_OFF = 0,
+	AUDIO_LINEAR,
+	AUDIO_SINC8,
+	AUDIO_SINC16,
+	AUDIO_SINC32
+};
+
+#define AUDIO_DEFAULT_QUALITY AUDIO_SINC16
+
+// Clocks the APU runs between reads of its band-limited step buffer.
+#define BLIP_FLUSH_CLOCKS    1024
+
+// sampler_t tracks the (variable) rate at which output samples are
+// produced, in CPU clocks per sample.
 typedef struct
 {
-	uint16_t factor_index;
 	uint16_t target_factor;
 	uint16_t equilibrium_factor;
 	uint16_t max_factor;
 	size_t   samples;
-	size_t   max_period;
-	size_t   min_period;
-	size_t   period;
-	size_t   counter;
-	size_t   index;
-	size_t   max_index;
+	size_t   steps;
+	double   max_period;
+	double   min_period;
+	double   period;
 
 } sampler_t;
 
@@ -49,4 +82,14 @@ extern const uint8_t length_counter_lookup[32];
 uint8_t divider_clock(divider_t *divider);
 uint8_t divider_clock_inverse(divider_t* divider);
 
+// divider_advance is equivalent to calling divider_clock the given
+// number of times, and returns the number of times it triggered.
+size_t divider_advance(divider_t* divider, size_t clocks);
+
+// divider_save writes the divider's state to the open save state
+// chunk, and divider_load reads it back. The step's range (limit and
+// from) is fixed by the channel, and not saved.
+void divider_save(divider_t* divider, state_t* state);
+void divider_load(divider_t* divider, state_t* state);
+
 #endif // NES_TOOLS_AUDIO_H
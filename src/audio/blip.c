@@ -0,0 +1,105 @@
+#include "blip.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// Cutoff of the impulse, as a fraction of the output sample rate.
+#define BLIP_CUTOFF 0.45
+
+float* blip_kernel_create(int width)
+{
+	if (width < 2 || width > BLIP_MAX_WIDTH || (width != 2 && width % 4)) {
+		LOG(ERROR, "Unsupported band-limited step width: %d", width);
+		return NULL;
+	}
+
+	float* kernel = malloc(sizeof(float) * BLIP_PHASES * width);
+	if (kernel == NULL) {
+		LOG(ERROR, "Failed to allocate band-limited step kernel");
+		return NULL;
+	}
+
+	for (int p = 0; p < BLIP_PHASES; p++) {
+		float* taps = kernel + p * width;
+		double frac = (double)p / BLIP_PHASES;
+
+		// Linear interpolation between the two nearest samples.
+		if (width == 2) {
+			taps[0] = 1 - frac;
+			taps[1] = frac;
+			continue;
+		}
+
+		double center = (width - 1) / 2.0 + frac - 0.5;
+		double sum = 0;
+
+		// Blackman-windowed sinc.
+		for (int i = 0; i < width; i++) {
+			double t = i - center;
+			double x = 2 * BLIP_CUTOFF * t;
+			double sinc = (x == 0) ? 1 : sin(M_PI * x) / (M_PI * x);
+			double w = 0.5 + t / width;
+			double window = (w <= 0 || w >= 1) ? 0 :
+				0.42 - 0.5 * cos(2 * M_PI * w) + 0.08 * cos(4 * M_PI * w);
+
+			taps[i] = sinc * window;
+			sum += taps[i];
+		}
+
+		// Every step must add exactly delta once integrated.
+		for (int i = 0; i < width; i++)
+			taps[i] /= sum;
+	}
+
+	return kernel;
+}
+
+void blip_kernel_destroy(float* kernel)
+{ free(kernel); }
+
+blip_t blip_create(const float* kernel, int width, double clocks_per_sample)
+{
+	blip_t blip;
+	memset(&blip, 0, sizeof(blip_t));
+	blip.kernel = kernel;
+	blip.width  = width;
+	blip_set_period(&blip, clocks_per_sample);
+	return blip;
+}
+
+void blip_set_period(blip_t* blip, double clocks_per_sample)
+{ blip->factor = (uint64_t)((double)(1ull << BLIP_TIME_BITS) / clocks_per_sample); }
+
+void blip_end_frame(blip_t* blip, uint32_t clocks)
+{
+	blip->offset += clocks * blip->factor;
+
+	// Should never trigger as long as frames are read in time.
+	if (blip_samples_avail(blip) > BLIP_BUFF_SIZE) {
+		LOG(ERROR, "Band-limited step buffer overflow");
+		blip->offset = (uint64_t)BLIP_BUFF_SIZE << BLIP_TIME_BITS;
+	}
+}
+
+size_t blip_read_samples(blip_t* blip, float* out, size_t count)
+{
+	size_t avail = blip_samples_avail(blip);
+	if (count > avail)
+		count = avail;
+
+	double sum = blip->integrator;
+	for (size_t i = 0; i < count; i++) {
+		sum += blip->buff[i];
+		out[i] = sum;
+	}
+	blip->integrator = sum;
+
+	// Shift the unread samples and the tails of their steps down.
+	size_t remain = avail - count + blip->width;
+	memmove(blip->buff, blip->buff + count, remain * sizeof(float));
+	memset(blip->buff + remain, 0, count * sizeof(float));
+	blip->offset -= (uint64_t)count << BLIP_TIME_BITS;
+
+	return count;
+}
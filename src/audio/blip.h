@@ -0,0 +1,103 @@
+#ifndef NES_TOOLS_BLIP_H
+#define NES_TOOLS_BLIP_H
+
+#include "../system.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Band-limited step synthesis (after Shay Green's blip_buf). Rather
+// than filtering the mixer output on every CPU cycle, the APU records
+// each change in amplitude with its cycle. Every change is added to
+// the output as a band-limited step: a windowed-sinc impulse, placed
+// at the change's sub-sample position, that the reader integrates.
+
+// Fractional sample positions are resolved to 1 / BLIP_PHASES.
+#define BLIP_PHASE_BITS 6
+#define BLIP_PHASES     (1 << BLIP_PHASE_BITS)
+
+// Longest supported impulse, in output samples.
+#define BLIP_MAX_WIDTH  32
+
+// Output samples the buffer can hold before they must be read.
+#define BLIP_BUFF_SIZE  64
+
+// Time is tracked in fixed point, with BLIP_TIME_BITS fractional bits
+// per output sample.
+#define BLIP_TIME_BITS  32
+
+// blip_t accumulates band-limited steps until they are read.
+typedef struct
+{
+	// Impulse per phase, see blip_kernel_create, and its length.
+	const float* kernel;
+	int          width;
+
+	// Output samples per clock, in fixed point.
+	uint64_t factor;
+
+	// Position of clock 0 of the current frame, in fixed point.
+	uint64_t offset;
+
+	// Running sum of the samples read so far.
+	double integrator;
+
+	float buff[BLIP_BUFF_SIZE + BLIP_MAX_WIDTH];
+
+} blip_t;
+
+// blip_kernel_create allocates the impulse table used by blip_t: for
+// each of BLIP_PHASES phases, width taps that sum to 1. A width of 2
+// gives linear interpolation; wider kernels are windowed sincs, which
+// cost more per step but alias less. width must be 2 or a multiple of
+// 4 up to BLIP_MAX_WIDTH.
+float* blip_kernel_create(int width);
+void blip_kernel_destroy(float* kernel);
+
+// blip_create returns an empty blip_t using the given kernel of the
+// given width, that produces one sample per clocks_per_sample clocks.
+blip_t blip_create(const float* kernel, int width, double clocks_per_sample);
+
+// blip_set_period changes the number of clocks per output sample. It
+// must be called between frames.
+void blip_set_period(blip_t* blip, double clocks_per_sample);
+
+// blip_add_delta adds a change in amplitude of delta at the given
+// clock of the current frame.
+static inline void blip_add_delta(blip_t* blip, uint32_t clock, float delta)
+{
+	uint64_t pos = blip->offset + clock * blip->factor;
+	const float* in = blip->kernel +
+		((pos >> (BLIP_TIME_BITS - BLIP_PHASE_BITS)) & (BLIP_PHASES - 1)) * blip->width;
+	float* out = blip->buff + (pos >> BLIP_TIME_BITS);
+
+#ifdef __SSE2__
+	if (blip->width % 4 == 0) {
+		__m128 d = _mm_set1_ps(delta);
+		for (int i = 0; i < blip->width; i += 4) {
+			__m128 o = _mm_loadu_ps(out + i);
+			o = _mm_add_ps(o, _mm_mul_ps(_mm_loadu_ps(in + i), d));
+			_mm_storeu_ps(out + i, o);
+		}
+		return;
+	}
+#endif
+	for (int i = 0; i < blip->width; i++)
+		out[i] += in[i] * delta;
+}
+
+// blip_end_frame ends the current frame after the given number of
+// clocks, making its samples available. The next frame starts at 0.
+// Samples past BLIP_BUFF_SIZE are dropped.
+void blip_end_frame(blip_t* blip, uint32_t clocks);
+
+// blip_samples_avail returns the number of samples that can be read.
+static inline size_t blip_samples_avail(const blip_t* blip)
+{ return blip->offset >> BLIP_TIME_BITS; }
+
+// blip_read_samples reads up to count samples into out, and returns
+// the number read.
+size_t blip_read_samples(blip_t* blip, float* out, size_t count);
+
+#endif // NES_TOOLS_BLIP_H
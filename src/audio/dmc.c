@@ -1,12 +1,12 @@
 #include "dmc.h"
 
-static uint16_t dmc_rate_index_ntsc[16] =
+static const uint16_t dmc_rate_index_ntsc[16] =
 {
 	428, 380, 340, 320, 286, 254, 226, 214,
 	190, 160, 142, 128, 106,  84,  72,  54
 };
 
-static uint16_t dmc_rate_index_pal[16] =
+static const uint16_t dmc_rate_index_pal[16] =
 {
 	398, 354, 316, 298, 276, 236, 210, 198,
 	176, 148, 132, 118,  98,  78,  66,  50
@@ -44,3 +44,64 @@ void dmc_set_addr(dmc_t* dmc, uint8_t val)
 
 void dmc_set_length(dmc_t* dmc, uint8_t val)
 { dmc->sample_length = (uint16_t)val * 16 + 1; }
+
+void dmc_advance_silent(dmc_t* dmc, size_t clocks)
+{
+	if (clocks <= dmc->rate_index) {
+		dmc->rate_index -= clocks;
+		return;
+	}
+
+	// Ticks of the rate timer: the first after rate_index + 1 clocks,
+	// then one every rate + 1 clocks.
+	clocks -= dmc->rate_index + 1;
+	size_t ticks = 1 + clocks / (dmc->rate + 1);
+	dmc->rate_index = dmc->rate - clocks % (dmc->rate + 1);
+
+	// Each tick counts the output shift register down, and the first
+	// brings it into the 8-bit cycle it then repeats.
+	uint8_t bits = (dmc->bits_remaining > 1) ? dmc->bits_remaining - 1 : 8;
+	dmc->bits_remaining = (bits - 1 + 8 - (ticks - 1) % 8) % 8 + 1;
+}
+
+void dmc_save(dmc_t* dmc, state_t* state)
+{
+	state_write_u8(state, dmc->enabled);
+	state_write_u8(state, dmc->irq_enable);
+	state_write_u8(state, dmc->loop);
+	state_write_u8(state, dmc->counter);
+	state_write_u16(state, dmc->sample_length);
+	state_write_u16(state, dmc->sample_addr);
+	state_write_u8(state, dmc->interrupt);
+	state_write_u8(state, dmc->irq_set);
+	state_write_u16(state, dmc->rate);
+	state_write_u16(state, dmc->rate_index);
+	state_write_u8(state, dmc->bits_remaining);
+	state_write_u8(state, dmc->silence);
+	state_write_u8(state, dmc->bits);
+	state_write_u8(state, dmc->sample);
+	state_write_u8(state, dmc->empty);
+	state_write_u16(state, dmc->bytes_remaining);
+	state_write_u16(state, dmc->current_addr);
+}
+
+void dmc_load(dmc_t* dmc, state_t* state)
+{
+	dmc->enabled         = state_read_u8(state);
+	dmc->irq_enable      = state_read_u8(state);
+	dmc->loop            = state_read_u8(state);
+	dmc->counter         = state_read_u8(state);
+	dmc->sample_length   = state_read_u16(state);
+	dmc->sample_addr     = state_read_u16(state);
+	dmc->interrupt       = state_read_u8(state);
+	dmc->irq_set         = state_read_u8(state);
+	dmc->rate            = state_read_u16(state);
+	dmc->rate_index      = state_read_u16(state);
+	dmc->bits_remaining  = state_read_u8(state);
+	dmc->silence         = state_read_u8(state);
+	dmc->bits            = state_read_u8(state);
+	dmc->sample          = state_read_u8(state);
+	dmc->empty           = state_read_u8(state);
+	dmc->bytes_remaining = state_read_u16(state);
+	dmc->current_addr    = state_read_u16(state);
+}
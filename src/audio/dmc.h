@@ -37,4 +37,14 @@ void dmc_set_da(dmc_t* dmc, uint8_t val);
 void dmc_set_addr(dmc_t* dmc, uint8_t val);
 void dmc_set_length(dmc_t* dmc, uint8_t val);
 
+// dmc_advance_silent runs the DMC's rate timer for the given number of
+// clocks while its output is silenced and its sample buffer is empty,
+// which leaves only the output shift register's bit count to update.
+void dmc_advance_silent(dmc_t* dmc, size_t clocks);
+
+// dmc_save writes the channel's state to the open save state chunk,
+// and dmc_load reads it back.
+void dmc_save(dmc_t* dmc, state_t* state);
+void dmc_load(dmc_t* dmc, state_t* state);
+
 #endif // NES_TOOLS_DMC_H
@@ -0,0 +1,119 @@
+#include "filter.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+filter_t filter_create(enum filter_type type, double freq, double rate)
+{
+	double rc = 1 / (2 * M_PI * freq);
+	double dt = 1 / rate;
+	filter_t filter = {0};
+
+	switch (type) {
+	case FILTER_HIGH_PASS: {
+		// y[n] = k * (y[n-1] + x[n] - x[n-1])
+		double k = rc / (rc + dt);
+		filter.a0 = k;
+		filter.a1 = -k;
+		filter.b1 = k;
+		break;
+	}
+	case FILTER_LOW_PASS: {
+		// y[n] = y[n-1] + k * (x[n] - y[n-1])
+		double k = dt / (rc + dt);
+		filter.a0 = k;
+		filter.a1 = 0;
+		filter.b1 = 1 - k;
+		break;
+	}
+	}
+
+	return filter;
+}
+
+int filter_chain_add(filter_chain_t* chain, filter_t filter)
+{
+	if (chain->count >= FILTER_CHAIN_SIZE) {
+		LOG(ERROR, "Too many filter stages");
+		return -1;
+	}
+	chain->stages[chain->count++] = filter;
+	return 0;
+}
+
+static void apply_scalar(filter_t* f, float* samples, size_t start, size_t count)
+{
+	float x1 = f->x1, y1 = f->y1;
+	for (size_t i = start; i < count; i++) {
+		float x = samples[i];
+		y1 = f->a0 * x + f->a1 * x1 + f->b1 * y1;
+		x1 = x;
+		samples[i] = y1;
+	}
+	f->x1 = x1;
+	f->y1 = y1;
+}
+
+#ifdef __SSE2__
+
+// The recursion is solved 4 samples at a time. With the feed-forward
+// part u[n] = a0 * x[n] + a1 * x[n-1] computed for the whole vector,
+// y[n] = u[n] + b1 * y[n-1] is a prefix scan: two shifted multiply-adds
+// (by b1 and b1^2) sum u within the vector, and y[n-1] of the previous
+// vector is carried in scaled by b1, b1^2, b1^3 and b1^4.
+static size_t apply_sse2(filter_t* f, float* samples, size_t count)
+{
+	const float b = f->b1;
+	const __m128 a0 = _mm_set1_ps(f->a0);
+	const __m128 a1 = _mm_set1_ps(f->a1);
+	const __m128 b1 = _mm_set1_ps(b);
+	const __m128 b2 = _mm_set1_ps(b * b);
+	const __m128 carry = _mm_setr_ps(b, b * b, b * b * b, b * b * b * b);
+
+	__m128 x1 = _mm_set1_ps(f->x1);
+	__m128 y1 = _mm_set1_ps(f->y1);
+
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128 x = _mm_loadu_ps(samples + i);
+
+		// x[n-1] for each lane: the previous vector's last input,
+		// then this vector's first three.
+		__m128 prev = _mm_shuffle_ps(x, x, _MM_SHUFFLE(2, 1, 0, 0));
+		prev = _mm_move_ss(prev, x1);
+
+		__m128 y = _mm_add_ps(_mm_mul_ps(a0, x), _mm_mul_ps(a1, prev));
+		y = _mm_add_ps(y, _mm_mul_ps(b1, _mm_castsi128_ps(
+			_mm_slli_si128(_mm_castps_si128(y), 4))));
+		y = _mm_add_ps(y, _mm_mul_ps(b2, _mm_castsi128_ps(
+			_mm_slli_si128(_mm_castps_si128(y), 8))));
+		y = _mm_add_ps(y, _mm_mul_ps(carry, y1));
+
+		_mm_storeu_ps(samples + i, y);
+		x1 = _mm_shuffle_ps(x, x, _MM_SHUFFLE(3, 3, 3, 3));
+		y1 = _mm_shuffle_ps(y, y, _MM_SHUFFLE(3, 3, 3, 3));
+	}
+
+	f->x1 = _mm_cvtss_f32(x1);
+	f->y1 = _mm_cvtss_f32(y1);
+	return i;
+}
+
+#endif // __SSE2__
+
+void filter_chain_apply(filter_chain_t* chain, float* samples, size_t count)
+{
+	for (int s = 0; s < chain->count; s++) {
+		filter_t* f = &chain->stages[s];
+		size_t done = 0;
+#ifdef __SSE2__
+		done = apply_sse2(f, samples, count);
+#endif
+		apply_scalar(f, samples, done, count);
+	}
+}
@@ -0,0 +1,49 @@
+#ifndef NES_TOOLS_FILTER_H
+#define NES_TOOLS_FILTER_H
+
+#include "../system.h"
+
+// Maximum number of stages in a filter_chain_t.
+#define FILTER_CHAIN_SIZE 4
+
+enum filter_type
+{
+	FILTER_HIGH_PASS,
+	FILTER_LOW_PASS
+};
+
+// filter_t is a first-order IIR filter:
+// y[n] = a0 * x[n] + a1 * x[n-1] + b1 * y[n-1]
+typedef struct
+{
+	float a0;
+	float a1;
+	float b1;
+
+	// Previous input and output.
+	float x1;
+	float y1;
+
+} filter_t;
+
+// filter_chain_t applies its stages in order.
+typedef struct
+{
+	filter_t stages[FILTER_CHAIN_SIZE];
+	int      count;
+
+} filter_chain_t;
+
+// filter_create returns a first-order RC filter with the given cutoff
+// frequency for signals sampled at rate.
+filter_t filter_create(enum filter_type type, double freq, double rate);
+
+// filter_chain_add appends a stage to the chain. It returns -1, and
+// leaves the chain as it is, if the chain is full.
+int filter_chain_add(filter_chain_t* chain, filter_t filter);
+
+// filter_chain_apply filters count samples in place, through every
+// stage of the chain.
+void filter_chain_apply(filter_chain_t* chain, float* samples, size_t count);
+
+#endif // NES_TOOLS_FILTER_H
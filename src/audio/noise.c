@@ -47,3 +47,38 @@ void noise_set_length(noise_t* noise, uint8_t val)
 
 	noise->envelope.step = 15;
 }
+
+void noise_shift(noise_t* noise)
+{
+	uint8_t feedback = (noise->shift & BIT_0) ^
+		(((noise->mode ? BIT_6 : BIT_1) & noise->shift) > 0);
+
+	noise->shift >>= 1;
+	noise->shift |= feedback ? (1 << 14) : 0;
+}
+
+void noise_save(noise_t* noise, state_t* state)
+{
+	divider_save(&noise->timer, state);
+	divider_save(&noise->envelope, state);
+	state_write_u8(state, noise->mode);
+	state_write_u8(state, noise->l);
+	state_write_u16(state, noise->shift);
+	state_write_u8(state, noise->const_volume);
+	state_write_u8(state, noise->envelope_loop);
+	state_write_u8(state, noise->enabled);
+}
+
+void noise_load(noise_t* noise, state_t* state)
+{
+	divider_load(&noise->timer, state);
+	divider_load(&noise->envelope, state);
+	noise->envelope.period &= 0xF;
+	noise->envelope.step   &= 0xF;
+	noise->mode          = state_read_u8(state);
+	noise->l             = state_read_u8(state);
+	noise->shift         = state_read_u16(state);
+	noise->const_volume  = state_read_u8(state);
+	noise->envelope_loop = state_read_u8(state);
+	noise->enabled       = state_read_u8(state);
+}
@@ -23,4 +23,12 @@ void noise_set_ctrl(noise_t* noise, uint8_t val);
 void noise_set_period(noise_t* noise, enum tv_system type, uint8_t val);
 void noise_set_length(noise_t* noise, uint8_t val);
 
+// noise_shift clocks the noise channel's shift register once.
+void noise_shift(noise_t* noise);
+
+// noise_save writes the channel's state to the open save state chunk,
+// and noise_load reads it back.
+void noise_save(noise_t* noise, state_t* state);
+void noise_load(noise_t* noise, state_t* state);
+
 #endif // NES_TOOLS_NOISE_H
@@ -77,3 +77,40 @@ void pulse_length_sweep(pulse_t* pulse)
 	if (pulse->l && !pulse->envelope.loop)
 		pulse->l--;
 }
+
+void pulse_save(pulse_t* pulse, state_t* state)
+{
+	divider_save(&pulse->t, state);
+	divider_save(&pulse->sweep, state);
+	divider_save(&pulse->envelope, state);
+	state_write_u8(state, pulse->l);
+	state_write_u8(state, pulse->neg);
+	state_write_u8(state, pulse->shift);
+	state_write_u8(state, pulse->enable_sweep);
+	state_write_u8(state, pulse->duty);
+	state_write_u8(state, pulse->const_volume);
+	state_write_u8(state, pulse->envelope_loop);
+	state_write_u8(state, pulse->enabled);
+	state_write_u8(state, pulse->mute);
+	state_write_u16(state, pulse->target_period);
+}
+
+void pulse_load(pulse_t* pulse, state_t* state)
+{
+	divider_load(&pulse->t, state);
+	pulse->t.step &= 0x7;
+	divider_load(&pulse->sweep, state);
+	divider_load(&pulse->envelope, state);
+	pulse->envelope.period &= 0xF;
+	pulse->envelope.step   &= 0xF;
+	pulse->l             = state_read_u8(state);
+	pulse->neg           = state_read_u8(state);
+	pulse->shift         = state_read_u8(state);
+	pulse->enable_sweep  = state_read_u8(state);
+	pulse->duty          = state_read_u8(state) & 0x3;
+	pulse->const_volume  = state_read_u8(state);
+	pulse->envelope_loop = state_read_u8(state);
+	pulse->enabled       = state_read_u8(state);
+	pulse->mute          = state_read_u8(state);
+	pulse->target_period = state_read_u16(state);
+}
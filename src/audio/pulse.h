@@ -29,4 +29,9 @@ void pulse_set_sweep(pulse_t* pulse, uint8_t value);
 void pulse_set_length_counter(pulse_t* pulse, uint8_t value);
 void pulse_length_sweep(pulse_t* pulse);
 
+// pulse_save writes the channel's state to the open save state chunk,
+// and pulse_load reads it back.
+void pulse_save(pulse_t* pulse, state_t* state);
+void pulse_load(pulse_t* pulse, state_t* state);
+
 #endif // NES_TOOLS_PULSE_H
@@ -0,0 +1,81 @@
+#include "ring.h"
+
+ring_t* ring_create(void)
+{
+	ring_t* ring = malloc(sizeof(ring_t));
+	if (ring == NULL) {
+		LOG(ERROR, "Failed to allocate audio ring");
+		return NULL;
+	}
+
+	memset(ring->samples, 0, sizeof(ring->samples));
+	atomic_init(&ring->head, 0);
+	atomic_init(&ring->tail, 0);
+	atomic_init(&ring->underruns, 0);
+	ring->write         = 0;
+	ring->cached_head   = 0;
+	ring->dropped       = 0;
+	ring->latency_sum   = 0;
+	ring->latency_count = 0;
+	ring->last          = 0;
+
+	return ring;
+}
+
+void ring_destroy(ring_t* ring)
+{ free(ring); }
+
+void ring_publish(ring_t* ring)
+{ atomic_store_explicit(&ring->tail, ring->write, memory_order_release); }
+
+void ring_discard(ring_t* ring)
+{ ring->write = atomic_load_explicit(&ring->tail, memory_order_relaxed); }
+
+size_t ring_fill(ring_t* ring)
+{
+	size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+	size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	return tail - head;
+}
+
+size_t ring_read(ring_t* ring, int16_t* out, size_t count)
+{
+	size_t head  = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	size_t tail  = atomic_load_explicit(&ring->tail, memory_order_acquire);
+	size_t avail = tail - head;
+	size_t n     = (avail < count) ? avail : count;
+
+	// Copy in at most two runs, around the end of the ring.
+	size_t start = head & RING_MASK;
+	size_t first = (n < RING_SIZE - start) ? n : RING_SIZE - start;
+	memcpy(out, ring->samples + start, first * sizeof(int16_t));
+	memcpy(out + first, ring->samples, (n - first) * sizeof(int16_t));
+	atomic_store_explicit(&ring->head, head + n, memory_order_release);
+
+	if (n)
+		ring->last = out[n - 1];
+
+	// Hold the last level rather than dropping to silence, which
+	// would click.
+	if (n < count) {
+		atomic_fetch_add_explicit(&ring->underruns, 1, memory_order_relaxed);
+		for (size_t i = n; i < count; i++)
+			out[i] = ring->last;
+	}
+
+	return n;
+}
+
+void ring_record_latency(ring_t* ring, size_t device_samples)
+{
+	ring->latency_sum += ring_fill(ring) + device_samples;
+	ring->latency_count++;
+}
+
+double ring_latency(const ring_t* ring)
+{
+	if (!ring->latency_count)
+		return 0;
+
+	return ring->latency_sum / ring->latency_count;
+}
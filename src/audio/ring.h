@@ -0,0 +1,80 @@
+#ifndef NES_TOOLS_RING_H
+#define NES_TOOLS_RING_H
+
+#include <stdatomic.h>
+
+#include "../system.h"
+
+// Capacity of ring_t in samples. Must be a power of two.
+#define RING_SIZE 8192
+#define RING_MASK (RING_SIZE - 1)
+
+// ring_t is a lock-free single-producer, single-consumer ring of audio
+// samples. The APU writes samples one at a time and publishes them in
+// batches; the SDL audio callback reads them. head and tail only ever
+// increase, and live on separate cache lines.
+typedef struct
+{
+	int16_t samples[RING_SIZE];
+
+	// Next sample the consumer reads.
+	_Alignas(64) atomic_size_t head;
+
+	// End of the published samples.
+	_Alignas(64) atomic_size_t tail;
+
+	// Producer only: end of the written (not yet published) samples,
+	// and the last head it has seen.
+	size_t write;
+	size_t cached_head;
+	size_t dropped;
+
+	// Producer only: latency statistics, see ring_record_latency.
+	double latency_sum;
+	size_t latency_count;
+
+	// Consumer only: callbacks that ran out of samples.
+	atomic_size_t underruns;
+	int16_t       last;
+
+} ring_t;
+
+// ring_create allocates an empty ring_t.
+ring_t* ring_create(void);
+void ring_destroy(ring_t* ring);
+
+// ring_write appends a sample without publishing it. If the ring is
+// full the sample is dropped.
+static inline void ring_write(ring_t* ring, int16_t sample)
+{
+	if (ring->write - ring->cached_head >= RING_SIZE) {
+		ring->cached_head = atomic_load_explicit(&ring->head, memory_order_acquire);
+		if (ring->write - ring->cached_head >= RING_SIZE) {
+			ring->dropped++;
+			return;
+		}
+	}
+	ring->samples[ring->write++ & RING_MASK] = sample;
+}
+
+// ring_publish makes the written samples visible to the consumer.
+void ring_publish(ring_t* ring);
+
+// ring_discard drops the written samples that were not published.
+void ring_discard(ring_t* ring);
+
+// ring_fill returns the number of published samples not read yet.
+size_t ring_fill(ring_t* ring);
+
+// ring_read copies up to count samples into out, and pads the rest by
+// repeating the last sample. It returns the number of samples read.
+size_t ring_read(ring_t* ring, int16_t* out, size_t count);
+
+// ring_record_latency records the latency of a sample published now:
+// the published samples ahead of it plus the device's buffer.
+void ring_record_latency(ring_t* ring, size_t device_samples);
+
+// ring_latency returns the average recorded latency in samples.
+double ring_latency(const ring_t* ring);
+
+#endif // NES_TOOLS_RING_H
@@ -56,3 +56,43 @@ uint8_t triangle_clock(triangle_t* tri)
 
 	return 1;
 }
+
+void triangle_advance(triangle_t* tri, size_t clocks)
+{
+	divider_t* divider = &tri->sequencer;
+	if (tri->length_counter && tri->linear_counter) {
+		divider_advance(divider, clocks);
+		return;
+	}
+
+	// The sequencer is halted: only the timer runs.
+	if (clocks <= (size_t)divider->counter) {
+		divider->counter -= clocks;
+		return;
+	}
+	clocks -= divider->counter + 1;
+	divider->counter = divider->period - clocks % (divider->period + 1);
+}
+
+void triangle_save(triangle_t* tri, state_t* state)
+{
+	divider_save(&tri->sequencer, state);
+	state_write_u8(state, tri->length_counter);
+	state_write_u8(state, tri->linear_reload);
+	state_write_u8(state, tri->linear_counter);
+	state_write_u8(state, tri->linear_reload_flag);
+	state_write_u8(state, tri->halt);
+	state_write_u8(state, tri->enabled);
+}
+
+void triangle_load(triangle_t* tri, state_t* state)
+{
+	divider_load(&tri->sequencer, state);
+	tri->sequencer.step    &= 0x1f;
+	tri->length_counter     = state_read_u8(state);
+	tri->linear_reload      = state_read_u8(state);
+	tri->linear_counter     = state_read_u8(state);
+	tri->linear_reload_flag = state_read_u8(state);
+	tri->halt               = state_read_u8(state);
+	tri->enabled            = state_read_u8(state);
+}
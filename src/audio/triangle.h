@@ -24,4 +24,13 @@ void triangle_set_timer_low(triangle_t* tri, uint8_t value);
 void triangle_set_length(triangle_t* tri, uint8_t value);
 uint8_t triangle_clock(triangle_t* tri);
 
+// triangle_advance is equivalent to calling triangle_clock the given
+// number of times.
+void triangle_advance(triangle_t* tri, size_t clocks);
+
+// triangle_save writes the channel's state to the open save state
+// chunk, and triangle_load reads it back.
+void triangle_save(triangle_t* tri, state_t* state);
+void triangle_load(triangle_t* tri, state_t* state);
+
 #endif // NES_TOOLS_TRIANGLE_H
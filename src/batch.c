@@ -0,0 +1,206 @@
+#include <unistd.h>
+
+#include "batch.h"
+
+#define RANGE(first, end) (((uint64_t)(end) << 32) | (uint32_t)(first))
+
+// take removes an index from a worker's range: the first one, or the
+// last one when stealing. It returns 0 once the range is empty.
+static int take(batch_worker_t* worker, uint8_t steal, size_t* index)
+{
+	uint64_t range = atomic_load_explicit(&worker->range, memory_order_relaxed);
+	for (;;) {
+		uint32_t first = (uint32_t)range;
+		uint32_t end   = (uint32_t)(range >> 32);
+		if (first >= end)
+			return 0;
+
+		uint64_t next = steal ? RANGE(first, end - 1) : RANGE(first + 1, end);
+		if (atomic_compare_exchange_weak_explicit(&worker->range, &range, next,
+				memory_order_relaxed, memory_order_relaxed)) {
+			*index = steal ? end - 1 : first;
+			return 1;
+		}
+	}
+}
+
+// step runs the frames of emulator i and writes its observations.
+static void step(batch_t* batch, size_t i)
+{
+	emulator_t* emu = batch->emus[i];
+	if (batch->actions) {
+		emulator_set_joypad(emu, 0, batch->actions[2 * i]);
+		emulator_set_joypad(emu, 1, batch->actions[2 * i + 1]);
+	} else {
+		emulator_set_joypad(emu, 0, 0);
+		emulator_set_joypad(emu, 1, 0);
+	}
+
+	for (unsigned frame = 0; frame < batch->repeat; frame++) {
+		emulator_run_frame(emu);
+		apu_discard_audio(emu->apu);
+	}
+
+	if (batch->screens) {
+		memcpy(batch->screens + i * BATCH_SCREEN_SIZE,
+		       emulator_screen(emu, NULL), BATCH_SCREEN_SIZE);
+	}
+	if (batch->ram)
+		memcpy(batch->ram + i * BATCH_RAM_SIZE, emulator_ram(emu), BATCH_RAM_SIZE);
+}
+
+// work steps the emulators in a worker's own range, then steals from
+// the others until every range is empty. Ranges only shrink during a
+// step, so one pass over them is enough.
+static void work(batch_t* batch, unsigned index)
+{
+	size_t i;
+	while (take(&batch->workers[index], 0, &i))
+		step(batch, i);
+
+	for (unsigned n = 1; n < batch->worker_count; n++) {
+		batch_worker_t* victim = &batch->workers[(index + n) % batch->worker_count];
+		while (take(victim, 1, &i))
+			step(batch, i);
+	}
+}
+
+static void* run_worker(void* data)
+{
+	batch_worker_t* self = data;
+	batch_t* batch = self->batch;
+	uint64_t seen = 0;
+
+	pthread_mutex_lock(&batch->lock);
+	for (;;) {
+		while (batch->generation == seen && !batch->exit)
+			pthread_cond_wait(&batch->start, &batch->lock);
+		if (batch->exit)
+			break;
+
+		seen = batch->generation;
+		pthread_mutex_unlock(&batch->lock);
+		work(batch, self->index);
+		pthread_mutex_lock(&batch->lock);
+
+		if (--batch->busy == 0)
+			pthread_cond_signal(&batch->done);
+	}
+	pthread_mutex_unlock(&batch->lock);
+	return NULL;
+}
+
+// stop wakes the workers 1 to count - 1 up to exit, and waits for them.
+static void stop(batch_t* batch, unsigned count)
+{
+	pthread_mutex_lock(&batch->lock);
+	batch->exit = 1;
+	pthread_cond_broadcast(&batch->start);
+	pthread_mutex_unlock(&batch->lock);
+
+	for (unsigned w = 1; w < count; w++)
+		pthread_join(batch->workers[w].thread, NULL);
+}
+
+batch_t* batch_create(emulator_t** emus, size_t count, unsigned threads)
+{
+	if (count == 0 || count > UINT32_MAX) {
+		LOG(ERROR, "Cannot batch %zu emulators", count);
+		return NULL;
+	}
+
+	if (threads == 0) {
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = (cpus > 0) ? cpus : 1;
+	}
+	if (threads > count)
+		threads = count;
+
+	batch_t* batch = malloc(sizeof(batch_t));
+	if (batch == NULL) {
+		LOG(ERROR, "Failed to allocate batch");
+		return NULL;
+	}
+
+	batch->workers = aligned_alloc(_Alignof(batch_worker_t),
+		sizeof(batch_worker_t) * threads);
+	if (batch->workers == NULL) {
+		LOG(ERROR, "Failed to allocate batch");
+		free(batch);
+		return NULL;
+	}
+
+	batch->emus         = emus;
+	batch->count        = count;
+	batch->worker_count = threads;
+	batch->actions      = NULL;
+	batch->repeat       = 1;
+	batch->screens      = NULL;
+	batch->ram          = NULL;
+	batch->generation   = 0;
+	batch->busy         = 0;
+	batch->exit         = 0;
+	pthread_mutex_init(&batch->lock, NULL);
+	pthread_cond_init(&batch->start, NULL);
+	pthread_cond_init(&batch->done, NULL);
+
+	for (unsigned w = 0; w < threads; w++) {
+		batch_worker_t* worker = &batch->workers[w];
+		atomic_init(&worker->range, 0);
+		worker->batch = batch;
+		worker->index = w;
+		if (w && pthread_create(&worker->thread, NULL, run_worker, worker)) {
+			LOG(ERROR, "Failed to start batch worker thread");
+			stop(batch, w);
+			batch_destroy(batch);
+			return NULL;
+		}
+	}
+
+	LOG(DEBUG, "Batching %zu emulators on %u threads", count, threads);
+	return batch;
+}
+
+void batch_destroy(batch_t* batch)
+{
+	if (!batch->exit)
+		stop(batch, batch->worker_count);
+
+	pthread_cond_destroy(&batch->done);
+	pthread_cond_destroy(&batch->start);
+	pthread_mutex_destroy(&batch->lock);
+	free(batch->workers);
+	free(batch);
+}
+
+void batch_step(batch_t* batch, const uint16_t* actions, unsigned repeat,
+	uint8_t* screens, uint8_t* ram)
+{
+	batch->actions = actions;
+	batch->repeat  = repeat ? repeat : 1;
+	batch->screens = screens;
+	batch->ram     = ram;
+
+	// Deal the emulators out in contiguous ranges. Uneven ones even
+	// out by stealing.
+	unsigned workers = batch->worker_count;
+	for (unsigned w = 0; w < workers; w++) {
+		atomic_store_explicit(&batch->workers[w].range, RANGE(
+			batch->count * w / workers,
+			batch->count * (w + 1) / workers), memory_order_relaxed);
+	}
+
+	pthread_mutex_lock(&batch->lock);
+	batch->busy = workers;
+	batch->generation++;
+	pthread_cond_broadcast(&batch->start);
+	pthread_mutex_unlock(&batch->lock);
+
+	work(batch, 0);
+
+	pthread_mutex_lock(&batch->lock);
+	batch->busy--;
+	while (batch->busy)
+		pthread_cond_wait(&batch->done, &batch->lock);
+	pthread_mutex_unlock(&batch->lock);
+}
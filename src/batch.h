@@ -0,0 +1,75 @@
+#ifndef NES_TOOLS_BATCH_H
+#define NES_TOOLS_BATCH_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "system.h"
+#include "emulator.h"
+
+// Bytes of each observation written by batch_step.
+#define BATCH_SCREEN_SIZE (VISIBLE_SCANLINES * VISIBLE_DOTS)
+#define BATCH_RAM_SIZE    RAM_SIZE
+
+struct batch_t;
+
+// batch_worker_t is one thread of a batch_t. range holds the emulators
+// it has left to step in the current batch_step, as a range of indices
+// packed into one word (first in the low 32 bits, end in the high 32
+// bits). The worker takes them from the front; idle workers steal from
+// the back.
+typedef struct
+{
+	_Alignas(64) atomic_uint_fast64_t range;
+	struct batch_t* batch;
+	unsigned        index;
+	pthread_t       thread;
+
+} batch_worker_t;
+
+// batch_t steps many independent emulators at once on a fixed pool of
+// worker threads. The thread calling batch_step is one of them.
+typedef struct batch_t
+{
+	emulator_t** emus;
+	size_t       count;
+
+	// Worker 0 is the thread calling batch_step.
+	batch_worker_t* workers;
+	unsigned        worker_count;
+
+	// The step being run, set by batch_step before it wakes the pool.
+	const uint16_t* actions;
+	unsigned        repeat;
+	uint8_t*        screens;
+	uint8_t*        ram;
+
+	// Workers wait for generation to change, then for the others to
+	// finish: busy counts the workers still stepping emulators.
+	pthread_mutex_t lock;
+	pthread_cond_t  start;
+	pthread_cond_t  done;
+	uint64_t        generation;
+	unsigned        busy;
+	uint8_t         exit;
+
+} batch_t;
+
+// batch_create sets up a pool of threads (including the caller's) to
+// step the count emulators in emus, which may share a mapper_t. If
+// threads is 0, one is used per online CPU. The emulators remain owned
+// by the caller and must outlive the batch.
+batch_t* batch_create(emulator_t** emus, size_t count, unsigned threads);
+void batch_destroy(batch_t* batch);
+
+// batch_step runs repeat frames (at least one) of every emulator, with
+// the joypads of emulator i held at actions[2 * i] and
+// actions[2 * i + 1] (none pressed if actions is NULL). It then writes
+// emulator i's screen (see emulator_screen) to screens + i *
+// BATCH_SCREEN_SIZE and its RAM to ram + i * BATCH_RAM_SIZE, each
+// skipped if NULL. Audio is dropped; select AUDIO_OFF (see
+// apu_set_quality) to skip synthesizing it.
+void batch_step(batch_t* batch, const uint16_t* actions, unsigned repeat,
+	uint8_t* screens, uint8_t* ram);
+
+#endif // NES_TOOLS_BATCH_H
@@ -1,5 +1,6 @@
 #include "bus.h"
 #include "ppu.h"
+#include "cpu6502.h"
 
 #include "audio/apu.h"
 #include "audio/triangle.h"
@@ -17,34 +18,86 @@ void bus_set_apu(bus_t* bus, struct apu_t* apu)
 void bus_set_ppu(bus_t* bus, struct ppu_t* ppu)
 { bus->ppu = ppu; }
 
-bus_t* bus_create(mapper_t* mapper)
+void bus_init(bus_t* bus, mapper_t* mapper, bus_data_t* data)
 {
-	bus_t* bus = malloc(sizeof(bus_t));
 	bus->mapper = mapper;
+	bus->data   = data;
 
-	memset(bus->ram, 0, RAM_SIZE);
-	bus->joy1 = joypad_create(0);
-	bus->joy2 = joypad_create(1);
-
-	return bus;
+	memset(data->ram, 0, RAM_SIZE);
+	data->joy1 = joypad_create(0);
+	data->joy2 = joypad_create(1);
+	bus->catch_up = 0;
+	bus_map_pages(bus);
 }
 
-void bus_destroy(bus_t* bus)
-{ free(bus); }
+void bus_map_pages(bus_t* bus)
+{
+	mapper_t* mapper = bus->mapper;
+	for (uint32_t page = 0; page < BUS_PAGES; page++) {
+		uint16_t addr = page << 8;
+		uint8_t* ptr = NULL;
+
+		// Internal RAM, mirrored every 2KB.
+		if (addr < RAM_END)
+			ptr = bus->data->ram + (addr % RAM_SIZE);
+
+		else if (addr >= 0x6000 && addr < 0x8000 && mapper->prg_ram != NULL)
+			ptr = mapper->prg_ram + (addr - 0x6000);
+
+		// PRG ROM is read-only: writes take the slow path.
+		else if (addr >= 0x8000) {
+			bus->read_map[page]  = mapper->prg_rom + ((addr - 0x8000) & mapper->clamp);
+			bus->write_map[page] = NULL;
+			continue;
+		}
+
+		bus->read_map[page]  = ptr;
+		bus->write_map[page] = ptr;
+	}
+}
 
-void bus_write(bus_t* bus, uint16_t addr, uint8_t val)
+// catch_up brings the circuit behind a memory-mapped register up to
+// date before the CPU accesses it. In catch-up mode the CPU has already
+// accounted for the whole instruction, which matches the cycle-accurate
+// loop where the PPU runs before the CPU and the APU after it.
+static void catch_up(bus_t* bus, uint16_t addr)
 {
-	uint8_t old = bus->bus;
-        bus->bus = val;
-	if (addr < RAM_END) {
-		bus->ram[addr % RAM_SIZE] = val;
+	if (addr < IO_REG_MIRRORED_END || addr == OAM_DMA) {
+		REQUIRE_PPU(bus->ppu, return);
+		if (bus->catch_up)
+			ppu_sync(bus->ppu, bus->cpu->t_cycles);
+
+		// Draw the pixels that precede this access.
+		ppu_flush(bus->ppu);
 		return;
 	}
 
+	if (bus->catch_up && addr <= FRAME_COUNTER && addr != JOY1) {
+		REQUIRE_APU(bus->apu, return);
+		apu_sync(bus->apu, bus->cpu->t_cycles - 1);
+	}
+}
+
+void bus_catch_up(bus_t* bus)
+{
+	if (!bus->catch_up || bus->ppu == NULL || bus->apu == NULL)
+		return;
+	ppu_sync(bus->ppu, bus->cpu->t_cycles);
+	apu_sync(bus->apu, bus->cpu->t_cycles - 1);
+}
+
+void bus_write_io(bus_t* bus, uint16_t addr, uint8_t val)
+{
+	uint8_t old = bus->data->bus;
+        bus->data->bus = val;
+
 	// resolve mirrored registers
 	if (addr < IO_REG_MIRRORED_END)
 		addr = 0x2000 + (addr - 0x2000) % 0x8;
 
+	if (addr < IO_REG_END)
+		catch_up(bus, addr);
+
 	// handle all IO registers
 	if (addr < IO_REG_END){
 		ppu_t* ppu = bus->ppu;
@@ -94,9 +147,9 @@ void bus_write(bus_t* bus, uint16_t addr, uint8_t val)
 			ppu->ppu_bus = val;
 			break;
 		case JOY1:
-			joypad_write(&bus->joy1, val);
-			joypad_write(&bus->joy2, val);
-			bus->bus = (old & 0xf0) | (val & 0xf);
+			joypad_write(&bus->data->joy1, val);
+			joypad_write(&bus->data->joy2, val);
+			bus->data->bus = (old & 0xf0) | (val & 0xf);
 			break;
 		case APU_P1_CTRL:
 			REQUIRE_APU(apu, break);
@@ -148,7 +201,7 @@ void bus_write(bus_t* bus, uint16_t addr, uint8_t val)
 			break;
 		case APU_NOISE_FREQ1:
 			REQUIRE_APU(apu, break);
-			noise_set_period(&apu->noise, apu->bus->mapper->type, val);
+			noise_set_period(&apu->noise, bus->mapper->type, val);
 			break;
 		case APU_NOISE_FREQ2:
 			REQUIRE_APU(apu, break);
@@ -186,73 +239,98 @@ void bus_write(bus_t* bus, uint16_t addr, uint8_t val)
 	mapper_write_rom(bus->mapper, addr, val);
 }
 
-uint8_t bus_read(bus_t* bus, uint16_t addr)
+uint8_t bus_read_io(bus_t* bus, uint16_t addr)
 {
-	if (addr < RAM_END) {
-		bus->bus = bus->ram[addr % RAM_SIZE];
-		return bus->bus;
-	}
-
 	// resolve mirrored registers
 	if (addr < IO_REG_MIRRORED_END)
 		addr = 0x2000 + (addr - 0x2000) % 0x8;
 
+	if (addr < IO_REG_END)
+		catch_up(bus, addr);
+
 	// handle all IO registers
 	if (addr < IO_REG_END) {
 		ppu_t* ppu = bus->ppu;
 		switch (addr) {
 		case PPU_STATUS:
-			REQUIRE_PPU(ppu, return bus->bus;);
+			REQUIRE_PPU(ppu, return bus->data->bus;);
 			ppu->ppu_bus &= 0x1f;
 			ppu->ppu_bus |= ppu_read_status(ppu) & 0xe0;
-			bus->bus = ppu->ppu_bus;
-			return bus->bus;
+			bus->data->bus = ppu->ppu_bus;
+			return bus->data->bus;
 		case OAM_DATA:
-			REQUIRE_PPU(ppu, return bus->bus;);
+			REQUIRE_PPU(ppu, return bus->data->bus;);
 			ppu->ppu_bus = ppu_read_oam(ppu);
-			bus->bus = ppu->ppu_bus;
-			return bus->bus;
+			bus->data->bus = ppu->ppu_bus;
+			return bus->data->bus;
 		case PPU_DATA:
-			REQUIRE_PPU(ppu, return bus->bus;);
+			REQUIRE_PPU(ppu, return bus->data->bus;);
 			ppu->ppu_bus = ppu_read(ppu);
-			bus->bus = ppu->ppu_bus;
-			return bus->bus;
+			bus->data->bus = ppu->ppu_bus;
+			return bus->data->bus;
 		case PPU_CTRL:
 		case PPU_MASK:
 		case PPU_SCROLL:
 		case PPU_ADDR:
 		case OAM_ADDR:
-			REQUIRE_PPU(ppu, return bus->bus;);
-			bus->bus = ppu->ppu_bus;
-			return bus->bus;
+			REQUIRE_PPU(ppu, return bus->data->bus;);
+			bus->data->bus = ppu->ppu_bus;
+			return bus->data->bus;
 		case JOY1:
-			bus->bus &= 0xe0;
-		        bus->bus |= joypad_read(&bus->joy1) & 0x1f;
-			return bus->bus;
+			bus->data->bus &= 0xe0;
+		        bus->data->bus |= joypad_read(&bus->data->joy1) & 0x1f;
+			return bus->data->bus;
 		case JOY2:
-		        bus->bus &= 0xe0;
-			bus->bus |= joypad_read(&bus->joy2) & 0x1f;
-			return bus->bus;
+		        bus->data->bus &= 0xe0;
+			bus->data->bus |= joypad_read(&bus->data->joy2) & 0x1f;
+			return bus->data->bus;
 		case APU_STATUS:
-			REQUIRE_APU(bus->apu, return bus->bus;);
-			bus->bus = apu_read_status(bus->apu);
-			return bus->bus;
+			REQUIRE_APU(bus->apu, return bus->data->bus;);
+			bus->data->bus = apu_read_status(bus->apu);
+			return bus->data->bus;
 		default: // open bus.
-			return bus->bus;
+			return bus->data->bus;
 		}
 	}
 
-	bus->bus = mapper_read_rom(bus->mapper, bus->bus, addr);
-	return bus->bus;
+	bus->data->bus = mapper_read_rom(bus->mapper, bus->data->bus, addr);
+	return bus->data->bus;
 }
 
 uint8_t* bus_get_ptr(bus_t* bus, uint16_t addr)
 {
-	if (addr < 0x2000)
-		return bus->ram + (addr % 0x800);
+	uint8_t* page = bus->read_map[addr >> 8];
+	if (page == NULL)
+		return NULL;
+
+	return page + (addr & 0xFF);
+}
+
+#define BUS_STATE_VERSION 1
+
+void bus_save(bus_t* bus, state_t* state)
+{
+	state_begin(state, "BUS ", BUS_STATE_VERSION);
+	state_write(state, bus->data->ram, RAM_SIZE);
+	state_write_u8(state, bus->data->bus);
+	state_write_u8(state, bus->data->joy1.strobe);
+	state_write_u8(state, bus->data->joy1.index);
+	state_write_u8(state, bus->data->joy2.strobe);
+	state_write_u8(state, bus->data->joy2.index);
+	state_end(state);
+}
+
+int bus_load(bus_t* bus, state_t* state)
+{
+	if (state_open(state, "BUS ", BUS_STATE_VERSION) < 0)
+		return -1;
 
-	if (addr > 0x6000 && addr < 0x8000 && bus->mapper->prg_ram != NULL)
-		return bus->mapper->prg_ram + (addr - 0x6000);
+	state_read(state, bus->data->ram, RAM_SIZE);
+	bus->data->bus         = state_read_u8(state);
+	bus->data->joy1.strobe = state_read_u8(state);
+	bus->data->joy1.index  = state_read_u8(state);
+	bus->data->joy2.strobe = state_read_u8(state);
+	bus->data->joy2.index  = state_read_u8(state);
 
-	return NULL;
+	return state->error ? -1 : 0;
 }
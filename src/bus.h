@@ -4,6 +4,7 @@
 #include "system.h"
 #include "mapper.h"
 #include "joypad.h"
+#include "state.h"
 
 #define IRQ_ADDRESS         0xFFFE
 #define NMI_ADDRESS         0xFFFA
@@ -12,6 +13,7 @@
 #define RAM_END             0x2000
 #define IO_REG_MIRRORED_END 0x4000
 #define IO_REG_END          0x4020
+#define BUS_PAGES           0x100
 
 enum
 {
@@ -60,17 +62,36 @@ struct cpu6502_t;
 struct apu_t;
 struct ppu_t;
 
+// bus_data_t is the state held on the bus: internal RAM, the value
+// last driven onto the bus (which reads of open bus return) and the
+// joypads.
+typedef struct
+{
+	uint8_t  ram[RAM_SIZE];
+	uint8_t  bus;
+	joypad_t joy1;
+	joypad_t joy2;
+
+} bus_data_t;
+
 // bus_t emulates an NES bus.
 typedef struct
 {
 	// Memory.
-	mapper_t* mapper;
-	uint8_t   ram[RAM_SIZE];
-	uint8_t   bus;
+	mapper_t*   mapper;
+	bus_data_t* data;
 
-	// Joypad controllers.
-	joypad_t joy1;
-	joypad_t joy2;
+	// Page tables: direct pointers to each 256-byte page of CPU
+	// memory backed by plain RAM or ROM. NULL pages (IO registers,
+	// expansion ROM, ROM writes) are handled by bus_read_io and
+	// bus_write_io.
+	uint8_t* read_map[BUS_PAGES];
+	uint8_t* write_map[BUS_PAGES];
+
+	// When set, the PPU and APU lag behind the CPU and are caught up
+	// to the current CPU cycle before any of their registers are
+	// accessed.
+	uint8_t catch_up;
 
 	// Bus-connected modules.
 	struct cpu6502_t* cpu;
@@ -79,18 +100,56 @@ typedef struct
 
 } bus_t;
 
-bus_t* bus_create(mapper_t* mapper);
-void bus_destroy(bus_t* bus);
+// bus_init connects the bus to the cartridge and to the memory it
+// holds, and maps its pages.
+void bus_init(bus_t* bus, mapper_t* mapper, bus_data_t* data);
+
+// bus_map_pages rebuilds the page tables from the mapper's current
+// memory layout.
+void bus_map_pages(bus_t* bus);
+
+// bus_write_io and bus_read_io access locations that are not directly
+// mapped by the page tables, such as memory-mapped registers.
+void bus_write_io(bus_t* bus, uint16_t addr, uint8_t val);
+uint8_t bus_read_io(bus_t* bus, uint16_t addr);
+
+// bus_catch_up brings the PPU and APU up to the CPU's current cycle in
+// catch-up mode, as the cycle-accurate loop has them when the CPU
+// finishes a cycle. Otherwise it does nothing.
+void bus_catch_up(bus_t* bus);
 
 // bus_write writes val to addr in main memory.
-void bus_write(bus_t* bus, uint16_t addr, uint8_t val);
+static inline void bus_write(bus_t* bus, uint16_t addr, uint8_t val)
+{
+	uint8_t* page = bus->write_map[addr >> 8];
+	if (page == NULL) {
+		bus_write_io(bus, addr, val);
+		return;
+	}
+	bus->data->bus = val;
+	page[addr & 0xFF] = val;
+}
 
 // bus_read fetches the value at addr from main memory.
-uint8_t bus_read(bus_t* bus, uint16_t addr);
+static inline uint8_t bus_read(bus_t* bus, uint16_t addr)
+{
+	uint8_t* page = bus->read_map[addr >> 8];
+	if (page == NULL)
+		return bus_read_io(bus, addr);
+	bus->data->bus = page[addr & 0xFF];
+	return bus->data->bus;
+}
 
 // bus_get_ptr gets a pointer to the value at addr in main memory.
 uint8_t* bus_get_ptr(bus_t* bus, uint16_t addr);
 
+// bus_save writes the bus's state (RAM and joypad shift registers) to a
+// "BUS " chunk, and bus_load reads it back. The joypads' buttons are
+// input, not state, and are left as they are. bus_load returns 0 on
+// success.
+void bus_save(bus_t* bus, state_t* state);
+int bus_load(bus_t* bus, state_t* state);
+
 // Eventually set all other NES circuits. bus_read/bus_write will be
 // able to access memory-mapped registers.
 void bus_set_cpu(bus_t* bus, struct cpu6502_t* cpu);
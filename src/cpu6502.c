@@ -1,7 +1,17 @@
 #include "cpu6502.h"
+#include "machine.h"
 
 #define DMA_CYCLES 513
 
+// GCC and Clang can force inlining and take the address of labels,
+// which cpu_step uses to jump straight into a fused handler per opcode.
+#if defined(__GNUC__)
+#define CPU_INLINE inline __attribute__((always_inline))
+#define CPU_COMPUTED_GOTO
+#else
+#define CPU_INLINE inline
+#endif
+
 static uint16_t read_abs_addr(bus_t* bus, uint16_t offset)
 {
 	// 16 bit address is little endian so read lo then hi
@@ -13,88 +23,92 @@ static uint16_t read_abs_addr(bus_t* bus, uint16_t offset)
 static uint8_t has_page_break(uint16_t addr1, uint16_t addr2)
 { return (addr1 & 0xFF00) != (addr2 & 0xFF00); }
 
-static uint16_t get_address(cpu6502_t* cpu)
+// get_address fetches the operand of an instruction and resolves its
+// effective address. It is always inlined so that it folds down to a
+// single addressing mode when called with constant arguments.
+static CPU_INLINE uint16_t get_address(cpu6502_t* cpu,
+	enum cpu_addr_mode mode, enum cpu_opcode opcode)
 {
 	uint16_t addr, hi, lo;
-	switch (cpu->instr->mode) {
+	switch (mode) {
         case IMPL:
         case ACC:
-		bus_read(cpu->bus, cpu->pc);
+		bus_read(cpu_bus(cpu), cpu->pc);
         case NONE:
 		return 0;
         case REL: {
-		int8_t offset = (int8_t)bus_read(cpu->bus, cpu->pc++);
+		int8_t offset = (int8_t)bus_read(cpu_bus(cpu), cpu->pc++);
 		return cpu->pc + offset;
         }
         case IMT:
 		return cpu->pc++;
         case ZPG:
-		return bus_read(cpu->bus, cpu->pc++) & 0xFF;
+		return bus_read(cpu_bus(cpu), cpu->pc++) & 0xFF;
         case ZPG_X:
-		addr = bus_read(cpu->bus, cpu->pc++);
+		addr = bus_read(cpu_bus(cpu), cpu->pc++);
 		return (addr + cpu->x) & 0xFF;
         case ZPG_Y:
-		addr = bus_read(cpu->bus, cpu->pc++);
+		addr = bus_read(cpu_bus(cpu), cpu->pc++);
 		return (addr + cpu->y) & 0xFF;
         case ABS:
-		addr = read_abs_addr(cpu->bus, cpu->pc);
+		addr = read_abs_addr(cpu_bus(cpu), cpu->pc);
 		cpu->pc += 2;
 		return addr;
         case ABS_X:
-		addr = read_abs_addr(cpu->bus, cpu->pc);
+		addr = read_abs_addr(cpu_bus(cpu), cpu->pc);
 		cpu->pc += 2;
-		switch (cpu->instr->opcode) {
+		switch (opcode) {
                 case STA: case ASL: case DEC: case INC:
 		case LSR: case ROL: case ROR: case SLO:
 		case RLA: case SRE: case RRA: case DCP:
 		case ISB: case SHY:
-			bus_read(cpu->bus, (addr & 0xff00) | ((addr + cpu->x) & 0xff));
+			bus_read(cpu_bus(cpu), (addr & 0xff00) | ((addr + cpu->x) & 0xff));
 			break;
                 default:
 			if (has_page_break(addr, addr + cpu->x)) {
-				bus_read(cpu->bus, (addr & 0xff00) | ((addr + cpu->x) & 0xff));
+				bus_read(cpu_bus(cpu), (addr & 0xff00) | ((addr + cpu->x) & 0xff));
 				cpu->cycles++;
 			}
 		}
 		return addr + cpu->x;
         case ABS_Y:
-		addr = read_abs_addr(cpu->bus, cpu->pc);
+		addr = read_abs_addr(cpu_bus(cpu), cpu->pc);
 		cpu->pc += 2;
-		switch (cpu->instr->opcode) {
+		switch (opcode) {
                 case STA: case SLO: case RLA: case SRE:
 		case RRA: case DCP: case ISB: case NOP:
-			bus_read(cpu->bus, (addr & 0xff00) | ((addr + cpu->y) & 0xff));
+			bus_read(cpu_bus(cpu), (addr & 0xff00) | ((addr + cpu->y) & 0xff));
 			break;
                 default:
 			if (has_page_break(addr, addr + cpu->y)) {
-				bus_read(cpu->bus, (addr & 0xff00) | ((addr + cpu->y) & 0xff));
+				bus_read(cpu_bus(cpu), (addr & 0xff00) | ((addr + cpu->y) & 0xff));
 				cpu->cycles++;
 			}
 		}
 		return addr + cpu->y;
         case IND:
-		addr = read_abs_addr(cpu->bus, cpu->pc);
+		addr = read_abs_addr(cpu_bus(cpu), cpu->pc);
 		cpu->pc += 2;
-		lo = bus_read(cpu->bus, addr);
-		hi = bus_read(cpu->bus, (addr & 0xFF00) | ((addr + 1) & 0xFF));
+		lo = bus_read(cpu_bus(cpu), addr);
+		hi = bus_read(cpu_bus(cpu), (addr & 0xFF00) | ((addr + 1) & 0xFF));
 		return (hi << 8) | lo;
         case IDX_IND:
-		addr = (bus_read(cpu->bus, cpu->pc++) + cpu->x) & 0xFF;
-		hi = bus_read(cpu->bus, (addr + 1) & 0xFF);
-		lo = bus_read(cpu->bus, addr & 0xFF);
+		addr = (bus_read(cpu_bus(cpu), cpu->pc++) + cpu->x) & 0xFF;
+		hi = bus_read(cpu_bus(cpu), (addr + 1) & 0xFF);
+		lo = bus_read(cpu_bus(cpu), addr & 0xFF);
 		return (hi << 8) | lo;
         case IND_IDX:
-		addr = bus_read(cpu->bus, cpu->pc++);
-		hi = bus_read(cpu->bus, (addr + 1) & 0xFF);
-		lo = bus_read(cpu->bus, addr & 0xFF);
+		addr = bus_read(cpu_bus(cpu), cpu->pc++);
+		hi = bus_read(cpu_bus(cpu), (addr + 1) & 0xFF);
+		lo = bus_read(cpu_bus(cpu), addr & 0xFF);
 		addr = (hi << 8) | lo;
-		switch (cpu->instr->opcode) {
+		switch (opcode) {
                 case STA:case SLO:case RLA:case SRE:case RRA:case DCP:case ISB: case NOP:
-			bus_read(cpu->bus, (addr & 0xff00) | ((addr + cpu->y) & 0xff));
+			bus_read(cpu_bus(cpu), (addr & 0xff00) | ((addr + cpu->y) & 0xff));
 			break;
                 default:
 			if (has_page_break(addr, addr + cpu->y)) {
-				bus_read(cpu->bus, (addr & 0xff00) | ((addr + cpu->y) & 0xff));
+				bus_read(cpu_bus(cpu), (addr & 0xff00) | ((addr + cpu->y) & 0xff));
 				cpu->cycles++;
 			}
 		}
@@ -118,28 +132,26 @@ static void fast_set_zn(cpu6502_t* cpu, uint8_t value)
 }
 
 static void stack_push(cpu6502_t* cpu, uint8_t value)
-{ bus_write(cpu->bus, STACK_START + cpu->sp--, value); }
+{ bus_write(cpu_bus(cpu), STACK_START + cpu->sp--, value); }
 
 static void stack_push_addr(cpu6502_t* cpu, uint16_t addr)
 {
-	bus_write(cpu->bus, STACK_START + cpu->sp--, addr >> 8);
-	bus_write(cpu->bus, STACK_START + cpu->sp--, addr & 0xFF);
+	bus_write(cpu_bus(cpu), STACK_START + cpu->sp--, addr >> 8);
+	bus_write(cpu_bus(cpu), STACK_START + cpu->sp--, addr & 0xFF);
 }
 
 static uint8_t stack_pop(cpu6502_t* cpu)
-{ return bus_read(cpu->bus, STACK_START + ++cpu->sp); }
+{ return bus_read(cpu_bus(cpu), STACK_START + ++cpu->sp); }
 
 static uint16_t stack_pop_addr(cpu6502_t* cpu)
 {
-	uint16_t addr = bus_read(cpu->bus, STACK_START + ++cpu->sp);
-	return addr | ((uint16_t)bus_read(cpu->bus, STACK_START + ++cpu->sp)) << 8;
+	uint16_t addr = bus_read(cpu_bus(cpu), STACK_START + ++cpu->sp);
+	return addr | ((uint16_t)bus_read(cpu_bus(cpu), STACK_START + ++cpu->sp)) << 8;
 }
 
-cpu6502_t* cpu_create(bus_t* bus)
+void cpu_init(cpu6502_t* cpu)
 {
-	cpu6502_t* cpu  = malloc(sizeof(cpu6502_t));
 	cpu->interrupt  = NOI;
-	cpu->bus        = bus;
 	cpu->ac         = 0;
 	cpu->x          = 0;
 	cpu->y          = 0;
@@ -148,28 +160,27 @@ cpu6502_t* cpu_create(bus_t* bus)
 	cpu->dma_cycles = 0;
 	cpu->odd_cycle  = 0;
 	cpu->t_cycles   = 0;
+	cpu->t_instr    = 0;
 	cpu->sr         = 0x24;
 	cpu->sp         = 0xfd;
-	cpu->pc         = read_abs_addr(cpu->bus, RESET_ADDRESS);
-	return cpu;
+	cpu->pc         = read_abs_addr(cpu_bus(cpu), RESET_ADDRESS);
+	cpu->opcode     = 0;
 }
 
-void cpu_destroy(cpu6502_t* cpu)
-{ free(cpu); }
-
 void cpu_reset(cpu6502_t* cpu)
 {
 	cpu->sr        |= INTERRUPT;
 	cpu->sp        -= 3;
-	cpu->pc         = read_abs_addr(cpu->bus, RESET_ADDRESS);
+	cpu->pc         = read_abs_addr(cpu_bus(cpu), RESET_ADDRESS);
 	cpu->cycles     = 0;
 	cpu->dma_cycles = 0;
 }
 
-static void branch(cpu6502_t* cpu, uint8_t mask, uint8_t predicate)
+static void branch(cpu6502_t* cpu, uint16_t addr, uint8_t mask,
+	uint8_t predicate)
 {
 	if (((cpu->sr & mask) > 0) == predicate) {
-		cpu->cycles += has_page_break(cpu->pc, cpu->addr);
+		cpu->cycles += has_page_break(cpu->pc, addr);
 		cpu->cycles++;
 		cpu->state |= BRANCH_STATE;
 		return;
@@ -177,32 +188,33 @@ static void branch(cpu6502_t* cpu, uint8_t mask, uint8_t predicate)
 	cpu->state &= ~BRANCH_STATE;
 }
 
-static void prep_branch(cpu6502_t* cpu)
+static CPU_INLINE void prep_branch(cpu6502_t* cpu, enum cpu_opcode opcode,
+	uint16_t addr)
 {
-	switch(cpu->instr->opcode){
+	switch(opcode){
         case BCC:
-		branch(cpu, CARRY, 0);
+		branch(cpu, addr, CARRY, 0);
 		break;
         case BCS:
-		branch(cpu, CARRY, 1);
+		branch(cpu, addr, CARRY, 1);
 		break;
         case BEQ:
-		branch(cpu, ZERO, 1);
+		branch(cpu, addr, ZERO, 1);
 		break;
         case BMI:
-		branch(cpu, NEGATIVE, 1);
+		branch(cpu, addr, NEGATIVE, 1);
 		break;
         case BNE:
-		branch(cpu, ZERO, 0);
+		branch(cpu, addr, ZERO, 0);
 		break;
         case BPL:
-		branch(cpu, NEGATIVE, 0);
+		branch(cpu, addr, NEGATIVE, 0);
 		break;
         case BVC:
-		branch(cpu, OVERFLW, 0);
+		branch(cpu, addr, OVERFLW, 0);
 		break;
         case BVS:
-		branch(cpu, OVERFLW, 1);
+		branch(cpu, addr, OVERFLW, 1);
 		break;
         default:
 		cpu->state &= ~BRANCH_STATE;
@@ -247,6 +259,16 @@ static uint8_t rot_r(cpu6502_t* cpu, uint8_t val)
 	return rotated;
 }
 
+// taken reports whether the CPU takes its pending interrupt before its
+// next instruction. An IRQ masked by the interrupt flag is dropped
+// without costing any cycles.
+static inline uint8_t taken(cpu6502_t* cpu)
+{
+	if (cpu->interrupt == IRQ && (cpu->sr & INTERRUPT))
+		cpu->interrupt = NOI;
+	return cpu->interrupt != NOI;
+}
+
 static void interrupt_(cpu6502_t* cpu)
 {
 	if ((cpu->sr & INTERRUPT) && cpu->interrupt != NMI) {
@@ -278,91 +300,37 @@ static void interrupt_(cpu6502_t* cpu)
 	stack_push(cpu, cpu->sr);
 	cpu->sr &= ~INTERRUPT;
 	cpu->sr |= INTERRUPT;
-	cpu->pc = read_abs_addr(cpu->bus, addr);
+	cpu->pc = read_abs_addr(cpu_bus(cpu), addr);
 	cpu->interrupt = NOI;
 }
 
-void cpu_dma_suspend(cpu6502_t* cpu)
-{
-	if (!cpu) return;
-
-	// Extra cycle on odd cycles.
-	cpu->dma_cycles += DMA_CYCLES + cpu->odd_cycle;
-}
-
-void cpu_exec(cpu6502_t* cpu)
+// execute carries out an instruction whose operand address has already
+// been resolved. Like get_address, it folds down to a single opcode when
+// called with constant arguments.
+static CPU_INLINE void execute(cpu6502_t* cpu, enum cpu_opcode opcode,
+	enum cpu_addr_mode mode, uint16_t address)
 {
-	cpu->odd_cycle ^= 1;
-	cpu->t_cycles++;
-
-	// Handle DMA suspended cycles.
-	if (cpu->dma_cycles != 0) {
-		cpu->dma_cycles--;
-		return;
-	}
-
-	// Poll for pending interrupts.
-	if (cpu->cycles == 0 && cpu->interrupt != NOI) {
-		cpu->state |= INTERRUPT_PENDING;
-
-		// Takes 7 cycles and this is one of them.
-		cpu->cycles = 7 - 1;
-
-		return;
-	}
-
-	// Fetch new instruction.
-	if (cpu->cycles == 0) {
-		uint8_t opcode = bus_read(cpu->bus, cpu->pc++);
-		cpu->instr = &cpu_instr_lookup[opcode];
-		cpu->addr = get_address(cpu);
-		cpu->cycles += cpu_cycle_lookup[opcode];
-
-		// Prepare for branching and adjust cycles accordingly
-		prep_branch(cpu);
-		cpu->cycles--;
-		return;
-	}
-
-	if (cpu->cycles == 1)
-		cpu->cycles--;
-
-	// Process current instruction.
-	if (cpu->cycles > 1) {
-		cpu->cycles--;
-		return;
-	}
-
-	// Handle pending interrupts.
-	if (cpu->state & INTERRUPT_PENDING) {
-		interrupt_(cpu);
-		cpu->state &= ~INTERRUPT_PENDING;
-		return;
-	}
-
-	// Execute current instruction.
-	uint16_t address = cpu->addr;
-	switch (cpu->instr->opcode) {
+	switch (opcode) {
         case LDA:
-		cpu->ac = bus_read(cpu->bus, address);
+		cpu->ac = bus_read(cpu_bus(cpu), address);
 		set_zn(cpu, cpu->ac);
 		break;
         case LDX:
-		cpu->x = bus_read(cpu->bus, address);
+		cpu->x = bus_read(cpu_bus(cpu), address);
 		set_zn(cpu, cpu->x);
 		break;
         case LDY:
-		cpu->y = bus_read(cpu->bus, address);
+		cpu->y = bus_read(cpu_bus(cpu), address);
 		set_zn(cpu, cpu->y);
 		break;
         case STA:
-		bus_write(cpu->bus, address, cpu->ac);
+		bus_write(cpu_bus(cpu), address, cpu->ac);
 		break;
         case STY:
-		bus_write(cpu->bus, address, cpu->y);
+		bus_write(cpu_bus(cpu), address, cpu->y);
 		break;
         case STX:
-		bus_write(cpu->bus, address, cpu->x);
+		bus_write(cpu_bus(cpu), address, cpu->x);
 		break;
         case TAX:
 		cpu->x = cpu->ac;
@@ -402,26 +370,26 @@ void cpu_exec(cpu6502_t* cpu)
 		cpu->sr |= stack_pop(cpu) & ~(BIT_4 | BIT_5);
 		break;
         case AND:
-		cpu->ac &= bus_read(cpu->bus, address);
+		cpu->ac &= bus_read(cpu_bus(cpu), address);
 		set_zn(cpu, cpu->ac);
 		break;
         case EOR:
-		cpu->ac ^= bus_read(cpu->bus, address);
+		cpu->ac ^= bus_read(cpu_bus(cpu), address);
 		set_zn(cpu, cpu->ac);
 		break;
         case ORA:
-		cpu->ac |= bus_read(cpu->bus, address);
+		cpu->ac |= bus_read(cpu_bus(cpu), address);
 		set_zn(cpu, cpu->ac);
 		break;
         case BIT: {
-		uint8_t opr = bus_read(cpu->bus, address);
+		uint8_t opr = bus_read(cpu_bus(cpu), address);
 		cpu->sr &= ~(NEGATIVE | OVERFLW | ZERO);
 		cpu->sr |= (!(opr & cpu->ac) ? ZERO: 0);
 		cpu->sr |= (opr & (NEGATIVE | OVERFLW));
 		break;
         }
         case ADC: {
-		uint8_t opr = bus_read(cpu->bus, address);
+		uint8_t opr = bus_read(cpu_bus(cpu), address);
 		uint16_t sum = cpu->ac + opr + ((cpu->sr & CARRY) != 0);
 		cpu->sr &= ~(CARRY | OVERFLW | NEGATIVE | ZERO);
 		cpu->sr |= (sum & 0xFF00 ? CARRY: 0);
@@ -431,7 +399,7 @@ void cpu_exec(cpu6502_t* cpu)
 		break;
         }
         case SBC: {
-		uint8_t opr = bus_read(cpu->bus, address);
+		uint8_t opr = bus_read(cpu_bus(cpu), address);
 		uint16_t diff = cpu->ac - opr - ((cpu->sr & CARRY) == 0);
 		cpu->sr &= ~(CARRY | OVERFLW | NEGATIVE | ZERO);
 		cpu->sr |= (!(diff & 0xFF00)) ? CARRY : 0;
@@ -441,30 +409,30 @@ void cpu_exec(cpu6502_t* cpu)
 		break;
         }
         case CMP: {
-		uint16_t diff = cpu->ac - bus_read(cpu->bus, address);
+		uint16_t diff = cpu->ac - bus_read(cpu_bus(cpu), address);
 		cpu->sr &= ~(CARRY | NEGATIVE | ZERO);
 		cpu->sr |= !(diff & 0xFF00) ? CARRY: 0;
 		fast_set_zn(cpu, diff);
 		break;
         }
         case CPX: {
-		uint16_t diff = cpu->x - bus_read(cpu->bus, address);
+		uint16_t diff = cpu->x - bus_read(cpu_bus(cpu), address);
 		cpu->sr &= ~(CARRY | NEGATIVE | ZERO);
 		cpu->sr |= !(diff & 0x100) ? CARRY: 0;
 		fast_set_zn(cpu, diff);
 		break;
         }
         case CPY: {
-		uint16_t diff = cpu->y - bus_read(cpu->bus, address);
+		uint16_t diff = cpu->y - bus_read(cpu_bus(cpu), address);
 		cpu->sr &= ~(CARRY | NEGATIVE | ZERO);
 		cpu->sr |= !(diff & 0xFF00) ? CARRY: 0;
 		fast_set_zn(cpu, diff);
 		break;
         }
         case DEC: {
-		uint8_t m = bus_read(cpu->bus, address);
-		bus_write(cpu->bus, address, m--);
-		bus_write(cpu->bus, address, m);
+		uint8_t m = bus_read(cpu_bus(cpu), address);
+		bus_write(cpu_bus(cpu), address, m--);
+		bus_write(cpu_bus(cpu), address, m);
 		set_zn(cpu, m);
 		break;
         }
@@ -477,9 +445,9 @@ void cpu_exec(cpu6502_t* cpu)
 		set_zn(cpu, cpu->y);
 		break;
         case INC: {
-		uint8_t m = bus_read(cpu->bus, address);
-		bus_write(cpu->bus, address, m++);
-		bus_write(cpu->bus, address, m);
+		uint8_t m = bus_read(cpu_bus(cpu), address);
+		bus_write(cpu_bus(cpu), address, m++);
+		bus_write(cpu_bus(cpu), address, m);
 		set_zn(cpu, m);
 		break;
         }
@@ -492,42 +460,42 @@ void cpu_exec(cpu6502_t* cpu)
 		set_zn(cpu, cpu->y);
 		break;
         case ASL:
-		if (cpu->instr->mode == ACC) {
+		if (mode == ACC) {
 			cpu->ac = shift_l(cpu, cpu->ac);
 			break;
 		}
-		uint8_t m = bus_read(cpu->bus, address);
-		bus_write(cpu->bus, address, m);
-		bus_write(cpu->bus, address, shift_l(cpu, m));
+		uint8_t m = bus_read(cpu_bus(cpu), address);
+		bus_write(cpu_bus(cpu), address, m);
+		bus_write(cpu_bus(cpu), address, shift_l(cpu, m));
 		break;
         case LSR: {
-		if (cpu->instr->mode == ACC) {
+		if (mode == ACC) {
 			cpu->ac = shift_r(cpu, cpu->ac);
 			break;
 		}
-		uint8_t m = bus_read(cpu->bus, address);
-		bus_write(cpu->bus, address, m);
-		bus_write(cpu->bus, address, shift_r(cpu, m));
+		uint8_t m = bus_read(cpu_bus(cpu), address);
+		bus_write(cpu_bus(cpu), address, m);
+		bus_write(cpu_bus(cpu), address, shift_r(cpu, m));
 		break;
 	}
         case ROL: {
-		if (cpu->instr->mode == ACC) {
+		if (mode == ACC) {
 			cpu->ac = rot_l(cpu, cpu->ac);
 			break;
 		}
-		uint8_t m = bus_read(cpu->bus, address);
-		bus_write(cpu->bus, address, m);
-		bus_write(cpu->bus, address, rot_l(cpu, m));
+		uint8_t m = bus_read(cpu_bus(cpu), address);
+		bus_write(cpu_bus(cpu), address, m);
+		bus_write(cpu_bus(cpu), address, rot_l(cpu, m));
 		break;
 	}
         case ROR: {
-		if (cpu->instr->mode == ACC) {
+		if (mode == ACC) {
 			cpu->ac = rot_r(cpu, cpu->ac);
 			break;
 		}
-		uint8_t m = bus_read(cpu->bus, address);
-		bus_write(cpu->bus, address, m);
-		bus_write(cpu->bus, address, rot_r(cpu, m));
+		uint8_t m = bus_read(cpu_bus(cpu), address);
+		bus_write(cpu_bus(cpu), address, m);
+		bus_write(cpu_bus(cpu), address, rot_r(cpu, m));
 		break;
 	}
         case JMP:
@@ -549,7 +517,7 @@ void cpu_exec(cpu6502_t* cpu)
 	case BVC:
 	case BVS:
 		if (cpu->state & BRANCH_STATE) {
-			cpu->pc = cpu->addr;
+			cpu->pc = address;
 			cpu->state &= ~BRANCH_STATE;
 		}
 		break;
@@ -578,7 +546,7 @@ void cpu_exec(cpu6502_t* cpu)
 		cpu->pc++;
 		stack_push_addr(cpu, cpu->pc);
 		stack_push(cpu, cpu->sr | BIT_5 | BIT_4);
-		cpu->pc = read_abs_addr(cpu->bus, IRQ_ADDRESS);
+		cpu->pc = read_abs_addr(cpu_bus(cpu), IRQ_ADDRESS);
 		cpu->sr |= INTERRUPT;
 		break;
         case RTI:
@@ -589,17 +557,17 @@ void cpu_exec(cpu6502_t* cpu)
         case NOP:
 		break;
         case ALR:
-		cpu->ac &= bus_read(cpu->bus, address);
+		cpu->ac &= bus_read(cpu_bus(cpu), address);
 		cpu->ac = shift_r(cpu, cpu->ac);
 		break;
         case ANC:
-		cpu->ac = cpu->ac & bus_read(cpu->bus, address);
+		cpu->ac = cpu->ac & bus_read(cpu_bus(cpu), address);
 		cpu->sr &= ~(CARRY | ZERO | NEGATIVE);
 		cpu->sr |= (cpu->ac & NEGATIVE) ? (CARRY | NEGATIVE): 0;
 		cpu->sr |= ((!cpu->ac)? ZERO: 0);
 		break;
         case ARR: {
-		uint8_t val = cpu->ac & bus_read(cpu->bus, address);
+		uint8_t val = cpu->ac & bus_read(cpu_bus(cpu), address);
 		uint8_t rotated = val >> 1;
 		rotated |= (cpu->sr & CARRY) << 7;
 		cpu->sr &= ~(CARRY | ZERO | NEGATIVE | OVERFLW);
@@ -610,7 +578,7 @@ void cpu_exec(cpu6502_t* cpu)
 		break;
         }
         case AXS: {
-		uint8_t opr = bus_read(cpu->bus, address);
+		uint8_t opr = bus_read(cpu_bus(cpu), address);
 		cpu->x = cpu->x & cpu->ac;
 		uint16_t diff = cpu->x - opr;
 		cpu->sr &= ~(CARRY | NEGATIVE | ZERO);
@@ -620,28 +588,28 @@ void cpu_exec(cpu6502_t* cpu)
 		break;
         }
         case LAX:
-		cpu->ac = bus_read(cpu->bus, address);
+		cpu->ac = bus_read(cpu_bus(cpu), address);
 		cpu->x = cpu->ac;
 		set_zn(cpu, cpu->ac);
 		break;
         case SAX: {
-		bus_write(cpu->bus, address, cpu->ac & cpu->x);
+		bus_write(cpu_bus(cpu), address, cpu->ac & cpu->x);
 		break;
         }
         case DCP: {
-		uint8_t m = bus_read(cpu->bus, address);
-		bus_write(cpu->bus, address, m--);
-		bus_write(cpu->bus, address, m);
-		uint16_t diff = cpu->ac - bus_read(cpu->bus, address);
+		uint8_t m = bus_read(cpu_bus(cpu), address);
+		bus_write(cpu_bus(cpu), address, m--);
+		bus_write(cpu_bus(cpu), address, m);
+		uint16_t diff = cpu->ac - bus_read(cpu_bus(cpu), address);
 		cpu->sr &= ~(CARRY | NEGATIVE | ZERO);
 		cpu->sr |= !(diff & 0xFF00) ? CARRY: 0;
 		fast_set_zn(cpu, diff);
 		break;
         }
         case ISB: {
-		uint8_t m = bus_read(cpu->bus, address);
-		bus_write(cpu->bus, address, m++);
-		bus_write(cpu->bus, address, m);
+		uint8_t m = bus_read(cpu_bus(cpu), address);
+		bus_write(cpu_bus(cpu), address, m++);
+		bus_write(cpu_bus(cpu), address, m);
 		uint16_t diff = cpu->ac - m - ((cpu->sr & CARRY) == 0);
 		cpu->sr &= ~(CARRY | OVERFLW | NEGATIVE | ZERO);
 		cpu->sr |= (!(diff & 0xFF00)) ? CARRY : 0;
@@ -651,19 +619,19 @@ void cpu_exec(cpu6502_t* cpu)
 		break;
         }
         case RLA: {
-		uint8_t m = bus_read(cpu->bus, address);
-		bus_write(cpu->bus, address, m);
+		uint8_t m = bus_read(cpu_bus(cpu), address);
+		bus_write(cpu_bus(cpu), address, m);
 		m = rot_l(cpu, m);
-		bus_write(cpu->bus, address, m);
+		bus_write(cpu_bus(cpu), address, m);
 		cpu->ac &= m;
 		set_zn(cpu, cpu->ac);
 		break;
         }
         case RRA: {
-		uint8_t m = bus_read(cpu->bus, address);
-		bus_write(cpu->bus, address, m);
+		uint8_t m = bus_read(cpu_bus(cpu), address);
+		bus_write(cpu_bus(cpu), address, m);
 		m = rot_r(cpu, m);
-		bus_write(cpu->bus, address, m);
+		bus_write(cpu_bus(cpu), address, m);
 		uint16_t sum = cpu->ac + m + ((cpu->sr & CARRY) != 0);
 		cpu->sr &= ~(CARRY | OVERFLW | NEGATIVE | ZERO);
 		cpu->sr |= (sum & 0xFF00 ? CARRY : 0);
@@ -673,31 +641,31 @@ void cpu_exec(cpu6502_t* cpu)
 		break;
         }
         case SLO: {
-		uint8_t m = bus_read(cpu->bus, address);
-		bus_write(cpu->bus, address, m);
+		uint8_t m = bus_read(cpu_bus(cpu), address);
+		bus_write(cpu_bus(cpu), address, m);
 		m = shift_l(cpu, m);
-		bus_write(cpu->bus, address, m);
+		bus_write(cpu_bus(cpu), address, m);
 		cpu->ac |= m;
 		set_zn(cpu, cpu->ac);
 		break;
         }
         case SRE: {
-		uint8_t m = bus_read(cpu->bus, address);
-		bus_write(cpu->bus, address, m);
+		uint8_t m = bus_read(cpu_bus(cpu), address);
+		bus_write(cpu_bus(cpu), address, m);
 		m = shift_r(cpu, m);
-		bus_write(cpu->bus, address, m);
+		bus_write(cpu_bus(cpu), address, m);
 		cpu->ac ^= m;
 		set_zn(cpu, cpu->ac);
 		break;
         }
         case SHY: {
 		uint8_t H = address >> 8, L = address & 0xff;
-		bus_write(cpu->bus, ((cpu->y & (H + 1)) << 8) | L, cpu->y & (H + 1));
+		bus_write(cpu_bus(cpu), ((cpu->y & (H + 1)) << 8) | L, cpu->y & (H + 1));
 		break;
         }
         case SHX: {
 		uint8_t H = address >> 8, L = address & 0xff;
-		bus_write(cpu->bus, ((cpu->x & (H + 1)) << 8) | L, cpu->x & (H + 1));
+		bus_write(cpu_bus(cpu), ((cpu->x & (H + 1)) << 8) | L, cpu->x & (H + 1));
 		break;
         }
         default:
@@ -705,5 +673,193 @@ void cpu_exec(cpu6502_t* cpu)
 	}
 }
 
+void cpu_dma_suspend(cpu6502_t* cpu)
+{
+	if (!cpu) return;
+
+	// Extra cycle on odd cycles.
+	cpu->dma_cycles += DMA_CYCLES + cpu->odd_cycle;
+}
+
+void cpu_exec(cpu6502_t* cpu)
+{
+	cpu->odd_cycle ^= 1;
+	cpu->t_cycles++;
+
+	// Handle DMA suspended cycles.
+	if (cpu->dma_cycles != 0) {
+		cpu->dma_cycles--;
+		return;
+	}
+
+	// Poll for pending interrupts.
+	if (cpu->cycles == 0 && taken(cpu)) {
+		cpu->state |= INTERRUPT_PENDING;
+
+		// Takes 7 cycles and this is one of them.
+		cpu->cycles = 7 - 1;
+
+		return;
+	}
+
+	// Fetch new instruction.
+	if (cpu->cycles == 0) {
+		uint8_t opcode = bus_read(cpu_bus(cpu), cpu->pc++);
+		const struct cpu_instr* instr = &cpu_instr_lookup[opcode];
+		cpu->opcode = opcode;
+		cpu->addr = get_address(cpu, instr->mode, instr->opcode);
+		cpu->cycles += cpu_cycle_lookup[opcode];
+		cpu->t_instr++;
+
+		// Prepare for branching and adjust cycles accordingly
+		prep_branch(cpu, instr->opcode, cpu->addr);
+		cpu->cycles--;
+		return;
+	}
+
+	if (cpu->cycles == 1)
+		cpu->cycles--;
+
+	// Process current instruction.
+	if (cpu->cycles > 1) {
+		cpu->cycles--;
+		return;
+	}
+
+	// Handle pending interrupts.
+	if (cpu->state & INTERRUPT_PENDING) {
+		interrupt_(cpu);
+		cpu->state &= ~INTERRUPT_PENDING;
+		return;
+	}
+
+	const struct cpu_instr* instr = &cpu_instr_lookup[cpu->opcode];
+	execute(cpu, instr->opcode, instr->mode, cpu->addr);
+}
+
+// retire accounts for the cycles of a decoded instruction before it is
+// executed, so that t_cycles already includes its last cycle.
+static CPU_INLINE uint16_t retire(cpu6502_t* cpu)
+{
+	uint16_t cycles = (uint8_t)(cpu->cycles - 1) + 1;
+	cpu->cycles = 0;
+	cpu->t_cycles += cycles;
+	cpu->odd_cycle ^= cycles & 1;
+	cpu->t_instr++;
+	return cycles;
+}
+
+// CPU_FUSED is the body of a fused handler. With the opcode, addressing
+// mode and cycle count known at compile time, get_address, prep_branch
+// and execute collapse into straight-line code for that opcode alone.
+#define CPU_FUSED(op, mode, n)                     \
+	cpu->cycles = n;                           \
+	addr = get_address(cpu, mode, op);         \
+	prep_branch(cpu, op, addr);                \
+	cycles = retire(cpu);                      \
+	execute(cpu, op, mode, addr);              \
+	return cycles;
+
+#define CPU_LABEL(code, op, mode, n)   op_##code: { CPU_FUSED(op, mode, n) }
+#define CPU_TARGET(code, op, mode, n)  [code] = &&op_##code,
+#define CPU_CASE(code, op, mode, n)    case code: { CPU_FUSED(op, mode, n) }
+
+uint16_t cpu_step(cpu6502_t* cpu)
+{
+	uint16_t cycles, addr;
+
+	// DMA suspended cycles elapse in one go.
+	if (cpu->dma_cycles != 0) {
+		cycles = cpu->dma_cycles;
+		cpu->dma_cycles = 0;
+		cpu->t_cycles += cycles;
+		cpu->odd_cycle ^= cycles & 1;
+		return cycles;
+	}
+
+	// Pending interrupts take 7 cycles. The one taken is the one
+	// pending on the last of them, so an NMI raised meanwhile hijacks
+	// an IRQ, as in cpu_exec.
+	if (taken(cpu)) {
+		cpu->t_cycles += 7;
+		cpu->odd_cycle ^= 1;
+		bus_catch_up(cpu_bus(cpu));
+		interrupt_(cpu);
+		return 7;
+	}
+
+	// Fetch the opcode and dispatch to its fused handler.
+	uint8_t opcode = bus_read(cpu_bus(cpu), cpu->pc++);
+
+#ifdef CPU_COMPUTED_GOTO
+	static void* const dispatch[256] = { CPU_INSTRUCTIONS(CPU_TARGET) };
+	goto *dispatch[opcode];
+	CPU_INSTRUCTIONS(CPU_LABEL)
+#else
+	switch (opcode) {
+	CPU_INSTRUCTIONS(CPU_CASE)
+	}
+#endif
+	return 0;
+}
+
 void cpu_interrupt(cpu6502_t* cpu, enum cpu_interrupt interrupt)
-{ cpu->interrupt = interrupt; }
+{
+	// An NMI takes priority over an IRQ raised while it is pending.
+	if (interrupt == IRQ && cpu->interrupt == NMI)
+		return;
+	cpu->interrupt = interrupt;
+}
+
+#define CPU_STATE_VERSION 1
+
+void cpu_save(cpu6502_t* cpu, state_t* state)
+{
+	state_begin(state, "CPU ", CPU_STATE_VERSION);
+	state_write_u8(state, cpu->state);
+	state_write_u16(state, cpu->addr);
+	state_write_u8(state, cpu->cycles);
+	state_write_u64(state, cpu->t_cycles);
+	state_write_u64(state, cpu->t_instr);
+	state_write_u16(state, cpu->dma_cycles);
+	state_write_u8(state, cpu->odd_cycle);
+	state_write_u16(state, cpu->pc);
+	state_write_u8(state, cpu->ac);
+	state_write_u8(state, cpu->x);
+	state_write_u8(state, cpu->y);
+	state_write_u8(state, cpu->sr);
+	state_write_u8(state, cpu->sp);
+	state_write_u8(state, cpu->interrupt);
+
+	// The instruction in progress, by opcode.
+	state_write_u8(state, cpu->opcode);
+	state_end(state);
+}
+
+int cpu_load(cpu6502_t* cpu, state_t* state)
+{
+	if (state_open(state, "CPU ", CPU_STATE_VERSION) < 0)
+		return -1;
+
+	cpu->state      = state_read_u8(state);
+	cpu->addr       = state_read_u16(state);
+	cpu->cycles     = state_read_u8(state);
+	cpu->t_cycles   = state_read_u64(state);
+	cpu->t_instr    = state_read_u64(state);
+	cpu->dma_cycles = state_read_u16(state);
+	cpu->odd_cycle  = state_read_u8(state);
+	cpu->pc         = state_read_u16(state);
+	cpu->ac         = state_read_u8(state);
+	cpu->x          = state_read_u8(state);
+	cpu->y          = state_read_u8(state);
+	cpu->sr         = state_read_u8(state);
+	cpu->sp         = state_read_u8(state);
+	cpu->interrupt  = state_read_u8(state);
+	cpu->opcode     = state_read_u8(state);
+
+	if (cpu->interrupt > IRQ) {
+		LOG(ERROR, "Save state has unknown interrupt %u", cpu->interrupt);
+		return -1;
+	}
+	return state->error ? -1 : 0;
+}
@@ -3,9 +3,9 @@
 
 #include "system.h"
 #include "bus.h"
+#include "state.h"
 
 #define STACK_START       0x100
-#define NIL_OP            {NOP, NONE}
 
 enum
 {
@@ -57,50 +57,88 @@ struct cpu_instr
 	enum cpu_addr_mode mode;
 };
 
+// CPU_INSTRUCTIONS lists every opcode (including unofficial ones) as
+// X(code, opcode, addressing mode, cycles). It generates the lookup
+// tables below and the fused per-opcode handlers of cpu_step.
+#define CPU_INSTRUCTIONS(X)                                                                                 \
+	X(0x00, BRK, IMPL, 7)    X(0x01, ORA, IDX_IND, 6) X(0x02, NOP, NONE, 0)    X(0x03, SLO, IDX_IND, 8) \
+	X(0x04, NOP, ZPG, 3)     X(0x05, ORA, ZPG, 3)     X(0x06, ASL, ZPG, 5)     X(0x07, SLO, ZPG, 5)     \
+	X(0x08, PHP, IMPL, 3)    X(0x09, ORA, IMT, 2)     X(0x0A, ASL, ACC, 2)     X(0x0B, ANC, IMT, 2)     \
+	X(0x0C, NOP, ABS, 4)     X(0x0D, ORA, ABS, 4)     X(0x0E, ASL, ABS, 6)     X(0x0F, SLO, ABS, 6)     \
+	X(0x10, BPL, REL, 2)     X(0x11, ORA, IND_IDX, 5) X(0x12, NOP, NONE, 0)    X(0x13, SLO, IND_IDX, 8) \
+	X(0x14, NOP, ZPG_X, 4)   X(0x15, ORA, ZPG_X, 4)   X(0x16, ASL, ZPG_X, 6)   X(0x17, SLO, ZPG_X, 6)   \
+	X(0x18, CLC, IMPL, 2)    X(0x19, ORA, ABS_Y, 4)   X(0x1A, NOP, IMPL, 2)    X(0x1B, SLO, ABS_Y, 7)   \
+	X(0x1C, NOP, ABS_X, 4)   X(0x1D, ORA, ABS_X, 4)   X(0x1E, ASL, ABS_X, 7)   X(0x1F, SLO, ABS_X, 7)   \
+	X(0x20, JSR, ABS, 6)     X(0x21, AND, IDX_IND, 6) X(0x22, NOP, NONE, 0)    X(0x23, RLA, IDX_IND, 8) \
+	X(0x24, BIT, ZPG, 3)     X(0x25, AND, ZPG, 3)     X(0x26, ROL, ZPG, 5)     X(0x27, RLA, ZPG, 5)     \
+	X(0x28, PLP, IMPL, 4)    X(0x29, AND, IMT, 2)     X(0x2A, ROL, ACC, 2)     X(0x2B, ANC, IMT, 2)     \
+	X(0x2C, BIT, ABS, 4)     X(0x2D, AND, ABS, 4)     X(0x2E, ROL, ABS, 6)     X(0x2F, RLA, ABS, 6)     \
+	X(0x30, BMI, REL, 2)     X(0x31, AND, IND_IDX, 5) X(0x32, NOP, NONE, 0)    X(0x33, RLA, IND_IDX, 8) \
+	X(0x34, NOP, ZPG_X, 4)   X(0x35, AND, ZPG_X, 4)   X(0x36, ROL, ZPG_X, 6)   X(0x37, RLA, ZPG_X, 6)   \
+	X(0x38, SEC, IMPL, 2)    X(0x39, AND, ABS_Y, 4)   X(0x3A, NOP, IMPL, 2)    X(0x3B, RLA, ABS_Y, 7)   \
+	X(0x3C, NOP, ABS_X, 4)   X(0x3D, AND, ABS_X, 4)   X(0x3E, ROL, ABS_X, 7)   X(0x3F, RLA, ABS_X, 7)   \
+	X(0x40, RTI, IMPL, 6)    X(0x41, EOR, IDX_IND, 6) X(0x42, NOP, NONE, 0)    X(0x43, SRE, IDX_IND, 8) \
+	X(0x44, NOP, ZPG, 3)     X(0x45, EOR, ZPG, 3)     X(0x46, LSR, ZPG, 5)     X(0x47, SRE, ZPG, 5)     \
+	X(0x48, PHA, IMPL, 3)    X(0x49, EOR, IMT, 2)     X(0x4A, LSR, ACC, 2)     X(0x4B, ALR, IMT, 2)     \
+	X(0x4C, JMP, ABS, 3)     X(0x4D, EOR, ABS, 4)     X(0x4E, LSR, ABS, 6)     X(0x4F, SRE, ABS, 6)     \
+	X(0x50, BVC, REL, 2)     X(0x51, EOR, IND_IDX, 5) X(0x52, NOP, NONE, 0)    X(0x53, SRE, IND_IDX, 8) \
+	X(0x54, NOP, ZPG_X, 4)   X(0x55, EOR, ZPG_X, 4)   X(0x56, LSR, ZPG_X, 6)   X(0x57, SRE, ZPG_X, 6)   \
+	X(0x58, CLI, IMPL, 2)    X(0x59, EOR, ABS_Y, 4)   X(0x5A, NOP, IMPL, 2)    X(0x5B, SRE, ABS_Y, 7)   \
+	X(0x5C, NOP, ABS_X, 4)   X(0x5D, EOR, ABS_X, 4)   X(0x5E, LSR, ABS_X, 7)   X(0x5F, SRE, ABS_X, 7)   \
+	X(0x60, RTS, IMPL, 6)    X(0x61, ADC, IDX_IND, 6) X(0x62, NOP, NONE, 0)    X(0x63, RRA, IDX_IND, 8) \
+	X(0x64, NOP, ZPG, 3)     X(0x65, ADC, ZPG, 3)     X(0x66, ROR, ZPG, 5)     X(0x67, RRA, ZPG, 5)     \
+	X(0x68, PLA, IMPL, 4)    X(0x69, ADC, IMT, 2)     X(0x6A, ROR, ACC, 2)     X(0x6B, ARR, IMT, 2)     \
+	X(0x6C, JMP, IND, 5)     X(0x6D, ADC, ABS, 4)     X(0x6E, ROR, ABS, 6)     X(0x6F, RRA, ABS, 6)     \
+	X(0x70, BVS, REL, 2)     X(0x71, ADC, IND_IDX, 5) X(0x72, NOP, NONE, 0)    X(0x73, RRA, IND_IDX, 8) \
+	X(0x74, NOP, ZPG_X, 4)   X(0x75, ADC, ZPG_X, 4)   X(0x76, ROR, ZPG_X, 6)   X(0x77, RRA, ZPG_X, 6)   \
+	X(0x78, SEI, IMPL, 2)    X(0x79, ADC, ABS_Y, 4)   X(0x7A, NOP, IMPL, 2)    X(0x7B, RRA, ABS_Y, 7)   \
+	X(0x7C, NOP, ABS_X, 4)   X(0x7D, ADC, ABS_X, 4)   X(0x7E, ROR, ABS_X, 7)   X(0x7F, RRA, ABS_X, 7)   \
+	X(0x80, NOP, IMT, 2)     X(0x81, STA, IDX_IND, 6) X(0x82, NOP, IMT, 2)     X(0x83, SAX, IDX_IND, 6) \
+	X(0x84, STY, ZPG, 3)     X(0x85, STA, ZPG, 3)     X(0x86, STX, ZPG, 3)     X(0x87, SAX, ZPG, 3)     \
+	X(0x88, DEY, IMPL, 2)    X(0x89, NOP, IMT, 2)     X(0x8A, TXA, IMPL, 2)    X(0x8B, NOP, IMT, 2)     \
+	X(0x8C, STY, ABS, 4)     X(0x8D, STA, ABS, 4)     X(0x8E, STX, ABS, 4)     X(0x8F, SAX, ABS, 4)     \
+	X(0x90, BCC, REL, 2)     X(0x91, STA, IND_IDX, 6) X(0x92, NOP, NONE, 0)    X(0x93, NOP, IND_IDX, 6) \
+	X(0x94, STY, ZPG_X, 4)   X(0x95, STA, ZPG_X, 4)   X(0x96, STX, ZPG_Y, 4)   X(0x97, SAX, ZPG_Y, 4)   \
+	X(0x98, TYA, IMPL, 2)    X(0x99, STA, ABS_Y, 5)   X(0x9A, TXS, IMPL, 2)    X(0x9B, NOP, ABS_Y, 5)   \
+	X(0x9C, SHY, ABS_X, 5)   X(0x9D, STA, ABS_X, 5)   X(0x9E, SHX, ABS_Y, 5)   X(0x9F, NOP, ABS_Y, 5)   \
+	X(0xA0, LDY, IMT, 2)     X(0xA1, LDA, IDX_IND, 6) X(0xA2, LDX, IMT, 2)     X(0xA3, LAX, IDX_IND, 6) \
+	X(0xA4, LDY, ZPG, 3)     X(0xA5, LDA, ZPG, 3)     X(0xA6, LDX, ZPG, 3)     X(0xA7, LAX, ZPG, 3)     \
+	X(0xA8, TAY, IMPL, 2)    X(0xA9, LDA, IMT, 2)     X(0xAA, TAX, IMPL, 2)    X(0xAB, LAX, IMT, 2)     \
+	X(0xAC, LDY, ABS, 4)     X(0xAD, LDA, ABS, 4)     X(0xAE, LDX, ABS, 4)     X(0xAF, LAX, ABS, 4)     \
+	X(0xB0, BCS, REL, 2)     X(0xB1, LDA, IND_IDX, 5) X(0xB2, NOP, NONE, 0)    X(0xB3, LAX, IND_IDX, 5) \
+	X(0xB4, LDY, ZPG_X, 4)   X(0xB5, LDA, ZPG_X, 4)   X(0xB6, LDX, ZPG_Y, 4)   X(0xB7, LAX, ZPG_Y, 4)   \
+	X(0xB8, CLV, IMPL, 2)    X(0xB9, LDA, ABS_Y, 4)   X(0xBA, TSX, IMPL, 2)    X(0xBB, LAS, ABS_Y, 4)   \
+	X(0xBC, LDY, ABS_X, 4)   X(0xBD, LDA, ABS_X, 4)   X(0xBE, LDX, ABS_Y, 4)   X(0xBF, LAX, ABS_Y, 4)   \
+	X(0xC0, CPY, IMT, 2)     X(0xC1, CMP, IDX_IND, 6) X(0xC2, NOP, IMT, 2)     X(0xC3, DCP, IDX_IND, 8) \
+	X(0xC4, CPY, ZPG, 3)     X(0xC5, CMP, ZPG, 3)     X(0xC6, DEC, ZPG, 5)     X(0xC7, DCP, ZPG, 5)     \
+	X(0xC8, INY, IMPL, 2)    X(0xC9, CMP, IMT, 2)     X(0xCA, DEX, IMPL, 2)    X(0xCB, AXS, IMT, 2)     \
+	X(0xCC, CPY, ABS, 4)     X(0xCD, CMP, ABS, 4)     X(0xCE, DEC, ABS, 6)     X(0xCF, DCP, ABS, 6)     \
+	X(0xD0, BNE, REL, 2)     X(0xD1, CMP, IND_IDX, 5) X(0xD2, NOP, NONE, 0)    X(0xD3, DCP, IND_IDX, 8) \
+	X(0xD4, NOP, ZPG_X, 4)   X(0xD5, CMP, ZPG_X, 4)   X(0xD6, DEC, ZPG_X, 6)   X(0xD7, DCP, ZPG_X, 6)   \
+	X(0xD8, CLD, IMPL, 2)    X(0xD9, CMP, ABS_Y, 4)   X(0xDA, NOP, IMPL, 2)    X(0xDB, DCP, ABS_Y, 7)   \
+	X(0xDC, NOP, ABS_X, 4)   X(0xDD, CMP, ABS_X, 4)   X(0xDE, DEC, ABS_X, 7)   X(0xDF, DCP, ABS_X, 7)   \
+	X(0xE0, CPX, IMT, 2)     X(0xE1, SBC, IDX_IND, 6) X(0xE2, NOP, IMT, 2)     X(0xE3, ISB, IDX_IND, 8) \
+	X(0xE4, CPX, ZPG, 3)     X(0xE5, SBC, ZPG, 3)     X(0xE6, INC, ZPG, 5)     X(0xE7, ISB, ZPG, 5)     \
+	X(0xE8, INX, IMPL, 2)    X(0xE9, SBC, IMT, 2)     X(0xEA, NOP, NONE, 2)    X(0xEB, SBC, IMT, 2)     \
+	X(0xEC, CPX, ABS, 4)     X(0xED, SBC, ABS, 4)     X(0xEE, INC, ABS, 6)     X(0xEF, ISB, ABS, 6)     \
+	X(0xF0, BEQ, REL, 2)     X(0xF1, SBC, IND_IDX, 5) X(0xF2, NOP, NONE, 0)    X(0xF3, ISB, IND_IDX, 8) \
+	X(0xF4, NOP, ZPG_X, 4)   X(0xF5, SBC, ZPG_X, 4)   X(0xF6, INC, ZPG_X, 6)   X(0xF7, ISB, ZPG_X, 6)   \
+	X(0xF8, SED, IMPL, 2)    X(0xF9, SBC, ABS_Y, 4)   X(0xFA, NOP, IMPL, 2)    X(0xFB, ISB, ABS_Y, 7)   \
+	X(0xFC, NOP, ABS_X, 4)   X(0xFD, SBC, ABS_X, 4)   X(0xFE, INC, ABS_X, 7)   X(0xFF, ISB, ABS_X, 7)
+
+#define CPU_INSTR_ENTRY(code, opcode, mode, cycles) [code] = {opcode, mode},
+#define CPU_CYCLE_ENTRY(code, opcode, mode, cycles) [code] = cycles,
+
 // 6502 instruction lookup table.
 static const struct cpu_instr cpu_instr_lookup[256] =
 {
-//  HI\LO        0x0          0x1          0x2             0x3           0x4             0x5         0x6           0x7           0x8           0x9           0xA        0xB            0xC             0xD          0xE           0xF
-// ----------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
-	/*  0x0  */  {BRK, IMPL},{ORA, IDX_IND}, NIL_OP,     {SLO, IDX_IND}, {NOP, ZPG},   {ORA, ZPG},   {ASL, ZPG},   {SLO, ZPG},   {PHP, IMPL}, {ORA, IMT},   {ASL, ACC},  {ANC, IMT},   {NOP, ABS},   {ORA, ABS},   {ASL, ABS},   {SLO, ABS},
-	/*  0x1  */  {BPL, REL}, {ORA, IND_IDX}, NIL_OP,     {SLO, IND_IDX}, {NOP, ZPG_X}, {ORA, ZPG_X}, {ASL, ZPG_X}, {SLO, ZPG_X}, {CLC, IMPL}, {ORA, ABS_Y}, {NOP, IMPL}, {SLO, ABS_Y}, {NOP, ABS_X}, {ORA, ABS_X}, {ASL, ABS_X}, {SLO, ABS_X},
-	/*  0x2  */  {JSR, ABS}, {AND, IDX_IND}, NIL_OP,     {RLA, IDX_IND}, {BIT, ZPG},   {AND, ZPG},   {ROL, ZPG},   {RLA, ZPG},   {PLP, IMPL}, {AND, IMT},   {ROL, ACC},  {ANC, IMT},   {BIT, ABS},   {AND, ABS},   {ROL, ABS},   {RLA, ABS},
-	/*  0x3  */  {BMI, REL}, {AND, IND_IDX}, NIL_OP,     {RLA, IND_IDX}, {NOP, ZPG_X}, {AND, ZPG_X}, {ROL, ZPG_X}, {RLA, ZPG_X}, {SEC, IMPL}, {AND, ABS_Y}, {NOP, IMPL}, {RLA, ABS_Y}, {NOP, ABS_X}, {AND, ABS_X}, {ROL, ABS_X}, {RLA, ABS_X},
-	/*  0x4  */  {RTI, IMPL},{EOR, IDX_IND}, NIL_OP,     {SRE, IDX_IND}, {NOP, ZPG},   {EOR, ZPG},   {LSR, ZPG},   {SRE, ZPG},   {PHA, IMPL}, {EOR, IMT},   {LSR, ACC},  {ALR, IMT},   {JMP, ABS},   {EOR, ABS},   {LSR, ABS},   {SRE, ABS},
-	/*  0x5  */  {BVC, REL}, {EOR, IND_IDX}, NIL_OP,     {SRE, IND_IDX}, {NOP, ZPG_X}, {EOR, ZPG_X}, {LSR, ZPG_X}, {SRE, ZPG_X}, {CLI, IMPL}, {EOR, ABS_Y}, {NOP, IMPL}, {SRE, ABS_Y}, {NOP, ABS_X}, {EOR, ABS_X}, {LSR, ABS_X}, {SRE, ABS_X},
-	/*  0x6  */  {RTS, IMPL},{ADC, IDX_IND}, NIL_OP,     {RRA, IDX_IND}, {NOP, ZPG},   {ADC, ZPG},   {ROR, ZPG},   {RRA, ZPG},   {PLA, IMPL}, {ADC, IMT},   {ROR, ACC},  {ARR, IMT},   {JMP, IND},   {ADC, ABS},   {ROR, ABS},   {RRA, ABS},
-	/*  0x7  */  {BVS, REL}, {ADC, IND_IDX}, NIL_OP,     {RRA, IND_IDX}, {NOP, ZPG_X}, {ADC, ZPG_X}, {ROR, ZPG_X}, {RRA, ZPG_X}, {SEI, IMPL}, {ADC, ABS_Y}, {NOP, IMPL}, {RRA, ABS_Y}, {NOP, ABS_X}, {ADC, ABS_X}, {ROR, ABS_X}, {RRA, ABS_X},
-	/*  0x8  */  {NOP, IMT}, {STA, IDX_IND}, {NOP, IMT}, {SAX, IDX_IND}, {STY, ZPG},   {STA, ZPG},   {STX, ZPG},   {SAX, ZPG},   {DEY, IMPL}, {NOP, IMT},   {TXA, IMPL}, {NOP, IMT},   {STY, ABS},   {STA, ABS},   {STX, ABS},   {SAX, ABS},
-	/*  0x9  */  {BCC, REL}, {STA, IND_IDX}, NIL_OP,     {NOP, IND_IDX}, {STY, ZPG_X}, {STA, ZPG_X}, {STX, ZPG_Y}, {SAX, ZPG_Y}, {TYA, IMPL}, {STA, ABS_Y}, {TXS, IMPL}, {NOP, ABS_Y}, {SHY, ABS_X}, {STA, ABS_X}, {SHX, ABS_Y}, {NOP, ABS_Y},
-	/*  0xA  */  {LDY, IMT}, {LDA, IDX_IND}, {LDX, IMT}, {LAX, IDX_IND}, {LDY, ZPG},   {LDA, ZPG},   {LDX, ZPG},   {LAX, ZPG},   {TAY, IMPL}, {LDA, IMT},   {TAX, IMPL}, {LAX, IMT},   {LDY, ABS},   {LDA, ABS},   {LDX, ABS},   {LAX, ABS},
-	/*  0xB  */  {BCS, REL}, {LDA, IND_IDX}, NIL_OP,     {LAX, IND_IDX}, {LDY, ZPG_X}, {LDA, ZPG_X}, {LDX, ZPG_Y}, {LAX, ZPG_Y}, {CLV, IMPL}, {LDA, ABS_Y}, {TSX, IMPL}, {LAS, ABS_Y}, {LDY, ABS_X}, {LDA, ABS_X}, {LDX, ABS_Y}, {LAX, ABS_Y},
-	/*  0xC  */  {CPY, IMT}, {CMP, IDX_IND}, {NOP, IMT}, {DCP, IDX_IND}, {CPY, ZPG},   {CMP, ZPG},   {DEC, ZPG},   {DCP, ZPG},   {INY, IMPL}, {CMP, IMT},   {DEX, IMPL}, {AXS, IMT},   {CPY, ABS},   {CMP, ABS},   {DEC, ABS},   {DCP, ABS},
-	/*  0xD  */  {BNE, REL}, {CMP, IND_IDX}, NIL_OP,     {DCP, IND_IDX}, {NOP, ZPG_X}, {CMP, ZPG_X}, {DEC, ZPG_X}, {DCP, ZPG_X}, {CLD, IMPL}, {CMP, ABS_Y}, {NOP, IMPL}, {DCP, ABS_Y}, {NOP, ABS_X}, {CMP, ABS_X}, {DEC, ABS_X}, {DCP, ABS_X},
-	/*  0xE  */  {CPX, IMT}, {SBC, IDX_IND}, {NOP, IMT}, {ISB, IDX_IND}, {CPX, ZPG},   {SBC, ZPG},   {INC, ZPG},   {ISB, ZPG},   {INX, IMPL}, {SBC, IMT},   NIL_OP,      {SBC, IMT},   {CPX, ABS},   {SBC, ABS},   {INC, ABS},   {ISB, ABS},
-	/*  0xF  */  {BEQ, REL}, {SBC, IND_IDX}, NIL_OP,     {ISB, IND_IDX}, {NOP, ZPG_X}, {SBC, ZPG_X}, {INC, ZPG_X}, {ISB, ZPG_X}, {SED, IMPL}, {SBC, ABS_Y}, {NOP, IMPL}, {ISB, ABS_Y}, {NOP, ABS_X}, {SBC, ABS_X}, {INC, ABS_X}, {ISB, ABS_X}
+	CPU_INSTRUCTIONS(CPU_INSTR_ENTRY)
 };
 
 // cycle times corresponding to each instruction in cpu_instr_lookup.
 static const uint8_t cpu_cycle_lookup[256] =
 {
-        // HI/LO 0  1  2  3  4  5  6  7  8  9  A  B  C  D  E  F
-        // -----------------------------------------------------
-	/* 0 */  7, 6, 0, 8, 3, 3, 5, 5, 3, 2, 2, 2, 4, 4, 6, 6,
-	/* 1 */  2, 5, 0, 8, 4, 4, 6, 6, 2, 4, 2, 7, 4, 4, 7, 7,
-	/* 2 */  6, 6, 0, 8, 3, 3, 5, 5, 4, 2, 2, 2, 4, 4, 6, 6,
-	/* 3 */  2, 5, 0, 8, 4, 4, 6, 6, 2, 4, 2, 7, 4, 4, 7, 7,
-	/* 4 */  6, 6, 0, 8, 3, 3, 5, 5, 3, 2, 2, 2, 3, 4, 6, 6,
-	/* 5 */  2, 5, 0, 8, 4, 4, 6, 6, 2, 4, 2, 7, 4, 4, 7, 7,
-	/* 6 */  6, 6, 0, 8, 3, 3, 5, 5, 4, 2, 2, 2, 5, 4, 6, 6,
-	/* 7 */  2, 5, 0, 8, 4, 4, 6, 6, 2, 4, 2, 7, 4, 4, 7, 7,
-	/* 8 */  2, 6, 2, 6, 3, 3, 3, 3, 2, 2, 2, 2, 4, 4, 4, 4,
-	/* 9 */  2, 6, 0, 6, 4, 4, 4, 4, 2, 5, 2, 5, 5, 5, 5, 5,
-	/* A */  2, 6, 2, 6, 3, 3, 3, 3, 2, 2, 2, 2, 4, 4, 4, 4,
-	/* B */  2, 5, 0, 5, 4, 4, 4, 4, 2, 4, 2, 4, 4, 4, 4, 4,
-	/* C */  2, 6, 2, 8, 3, 3, 5, 5, 2, 2, 2, 2, 4, 4, 6, 6,
-	/* D */  2, 5, 0, 8, 4, 4, 6, 6, 2, 4, 2, 7, 4, 4, 7, 7,
-	/* E */  2, 6, 2, 8, 3, 3, 5, 5, 2, 2, 2, 2, 4, 4, 6, 6,
-	/* F */  2, 5, 0, 8, 4, 4, 6, 6, 2, 4, 2, 7, 4, 4, 7, 7,
+	CPU_INSTRUCTIONS(CPU_CYCLE_ENTRY)
 };
 
 enum cpu_interrupt
@@ -116,11 +154,11 @@ typedef struct cpu6502_t
 {
 	uint8_t  state;
 	uint16_t addr;
-	bus_t*   bus;
 
 	// Cycle state.
 	uint8_t  cycles;
 	size_t   t_cycles;
+	size_t   t_instr;
 	uint16_t dma_cycles;
 	uint8_t  odd_cycle;
 
@@ -135,12 +173,14 @@ typedef struct cpu6502_t
 	// Interrupt flag.
 	enum cpu_interrupt interrupt;
 
-	const struct cpu_instr* instr;
+	// Index into cpu_instr_lookup of the instruction being executed.
+	uint8_t  opcode;
 
 } cpu6502_t;
 
-cpu6502_t* cpu_create(bus_t* bus);
-void cpu_destroy(cpu6502_t* cpu);
+// cpu_init powers on the CPU of a machine (see machine.h), whose bus
+// must already be set up.
+void cpu_init(cpu6502_t* cpu);
 
 // cpu_reset performs a soft-reset.
 void cpu_reset(cpu6502_t* cpu);
@@ -148,10 +188,22 @@ void cpu_reset(cpu6502_t* cpu);
 // cpu_exec executes a single CPU cycle.
 void cpu_exec(cpu6502_t* cpu);
 
+// cpu_step executes a whole instruction (or interrupt, or DMA stall)
+// at once and returns the number of CPU cycles it took. Bus accesses
+// happen immediately, so the caller must advance the other circuits
+// by the returned number of cycles.
+uint16_t cpu_step(cpu6502_t* cpu);
+
 // cpu_dma_suspend suspends the CPU for 513 cycles for DMA transfer.
 void cpu_dma_suspend(cpu6502_t* cpu);
 
-// cpu_interrupt queues an interrupt.
+// cpu_interrupt queues an interrupt. A pending NMI is not replaced by
+// an IRQ.
 void cpu_interrupt(cpu6502_t* cpu, enum cpu_interrupt interrupt);
 
+// cpu_save writes the CPU's state to a "CPU " chunk, and cpu_load reads
+// it back. cpu_load returns 0 on success.
+void cpu_save(cpu6502_t* cpu, state_t* state);
+int cpu_load(cpu6502_t* cpu, state_t* state);
+
 #endif // NES_TOOLS_CPU6502_H
@@ -0,0 +1,87 @@
+#include "delta.h"
+
+// Runs of fewer equal bytes than this are kept in the literal run
+// around them, as they would take as much room to encode as a run.
+#define MIN_ZERO_RUN 4
+
+static size_t put_varint(uint8_t* out, size_t val)
+{
+	size_t len = 0;
+	while (val >= 0x80) {
+		out[len++] = (val & 0x7f) | 0x80;
+		val >>= 7;
+	}
+	out[len++] = val;
+	return len;
+}
+
+// get_varint reads a varint from the avail bytes at in into val. It
+// returns its length, or 0 if it does not end within them or does not
+// fit in a size_t.
+static size_t get_varint(const uint8_t* in, size_t avail, size_t* val)
+{
+	size_t len = 0;
+	*val = 0;
+	do {
+		if (len == avail || 7 * len >= 8 * sizeof(size_t))
+			return 0;
+		*val |= (size_t)(in[len] & 0x7f) << (7 * len);
+	} while (in[len++] & 0x80);
+	return len;
+}
+
+size_t delta_encode(const uint8_t* a, const uint8_t* b, size_t len, uint8_t* out)
+{
+	uint8_t* start = out;
+	size_t i = 0;
+
+	while (i < len) {
+		size_t zeros = i;
+		while (i + 8 <= len && !memcmp(a + i, b + i, 8))
+			i += 8;
+		while (i < len && a[i] == b[i])
+			i++;
+		zeros = i - zeros;
+
+		size_t lit = i, same = 0;
+		while (i < len && same < MIN_ZERO_RUN) {
+			same = (a[i] == b[i]) ? same + 1 : 0;
+			i++;
+		}
+		if (same == MIN_ZERO_RUN)
+			i -= MIN_ZERO_RUN;
+
+		out += put_varint(out, zeros);
+		out += put_varint(out, i - lit);
+		for (size_t k = lit; k < i; k++)
+			*out++ = a[k] ^ b[k];
+	}
+	return out - start;
+}
+
+int delta_apply(uint8_t* state, size_t size, const uint8_t* in, size_t len)
+{
+	const uint8_t* end = in + len;
+	size_t i = 0;
+
+	while (in < end) {
+		size_t zeros, lit, n;
+		if (!(n = get_varint(in, end - in, &zeros)))
+			return -1;
+		in += n;
+		if (!(n = get_varint(in, end - in, &lit)))
+			return -1;
+		in += n;
+
+		if (zeros > size - i || lit > size - i - zeros ||
+		    lit > (size_t)(end - in))
+			return -1;
+
+		i += zeros;
+		for (size_t k = 0; k < lit; k++)
+			state[i + k] ^= in[k];
+		in += lit;
+		i  += lit;
+	}
+	return 0;
+}
@@ -0,0 +1,24 @@
+#ifndef NES_TOOLS_DELTA_H
+#define NES_TOOLS_DELTA_H
+
+#include "system.h"
+
+// A delta is the XOR of two buffers of the same length, which is
+// mostly zeros when they are two states of a machine close in time. It
+// is stored as pairs of runs: a varint count of zero bytes, then a
+// varint count of literal bytes followed by them.
+
+// Largest encoding of a delta between buffers of len bytes.
+#define DELTA_MAX_SIZE(len) (2 * (len) + 16)
+
+// delta_encode writes the delta of a and b (len bytes each) to out,
+// and returns its length.
+size_t delta_encode(const uint8_t* a, const uint8_t* b, size_t len, uint8_t* out);
+
+// delta_apply XORs the delta at in (len bytes) into state (size
+// bytes), turning either buffer it was encoded from into the other. It
+// returns -1, leaving state partly changed, if the delta is malformed
+// or reaches past the end of state, and 0 otherwise.
+int delta_apply(uint8_t* state, size_t size, const uint8_t* in, size_t len);
+
+#endif // NES_TOOLS_DELTA_H
@@ -1,11 +1,14 @@
 #include "emulator.h"
-#include "snapshot.h"
 
 emulator_t* emulator_create(mapper_t* mapper)
 {
 	emulator_t* emu = malloc(sizeof(emulator_t));
-	emu->mapper = mapper;
+	if (emu == NULL) {
+		LOG(ERROR, "Failed to allocate emulator");
+		return NULL;
+	}
 	emu->type   = mapper->type;
+	emu->sync   = SYNC_CYCLE;
 
 	emu->period = (emu->type == PAL) ?
 		1000000000 / PAL_FRAME_RATE :
@@ -15,168 +18,324 @@ emulator_t* emulator_create(mapper_t* mapper)
 		PAL_FRAME_RATE / PAL_TURBO_RATE :
 		NTSC_FRAME_RATE / NTSC_TURBO_RATE;
 
-	if (!(emu->gfx = gfx_create(256, 240, 2))) {
+	if (!(emu->machine = machine_create(mapper))) {
 		free(emu);
 		return NULL;
 	}
+	emu->mapper = &emu->machine->cart;
 
-	emu->gfx->screen_width = -1;
-	emu->gfx->screen_height = -1;
+	emu->cpu = &emu->machine->state.cpu;
+	emu->ppu = &emu->machine->state.ppu;
+	emu->apu = &emu->machine->state.apu;
+	emu->bus = &emu->machine->bus;
 
-	if (!(emu->bus = bus_create(emu->mapper))) {
-		gfx_destroy(emu->gfx);
+	palette_init(&emu->palette, emu->type);
+	emu->frame = malloc(sizeof(uint32_t) * VISIBLE_SCANLINES * VISIBLE_DOTS);
+	if (emu->frame == NULL) {
+		LOG(ERROR, "Failed to allocate emulator");
+		machine_destroy(emu->machine);
 		free(emu);
 		return NULL;
 	}
 
-	if (!(emu->ppu = ppu_create(emu->bus))) {
-		bus_destroy(emu->bus);
-		gfx_destroy(emu->gfx);
-		free(emu);
-		return NULL;
+	emu->path  = NULL;
+	emu->rewind    = NULL;
+	emu->rewinding = 0;
+
+	emu->run_ahead   = 0;
+	emu->ahead_state = NULL;
+	emu->ahead_ms    = 0;
+	emu->ahead_count = 0;
+	emu->movie = NULL;
+	emu->reset = 0;
+	emu->time_diff = 0;
+
+	return emu;
+}
+
+void emulator_run_frame(emulator_t* emu)
+{
+	ppu_t* ppu     = emu->ppu;
+	cpu6502_t* cpu = emu->cpu;
+	apu_t* apu     = emu->apu;
+
+	emu->bus->catch_up = (emu->sync == SYNC_CATCHUP);
+
+	// If ppu.render is set a frame is complete
+	if (emu->sync == SYNC_CATCHUP) {
+		while (!ppu->render) {
+			// Events are counted from where the PPU and APU are,
+			// which is behind the CPU after a frame completes.
+			size_t deadline = ppu->cycles + ppu_next_event(ppu);
+			size_t apu_next = apu_next_event(apu);
+			if (apu_next != SIZE_MAX && apu->cycles + apu_next < deadline)
+				deadline = apu->cycles + apu_next;
+
+			while (cpu->t_cycles < deadline)
+				cpu_step(cpu);
+
+			// The CPU polls for interrupts on the first cycle of
+			// its next instruction, after the PPU has run it.
+			ppu_sync(ppu, cpu->t_cycles + 1);
+			apu_sync(apu, cpu->t_cycles);
+		}
 	}
+	else if (emu->sync == SYNC_INSTR) {
+		while (!ppu->render) {
+			uint16_t cycles = cpu_step(cpu);
+			ppu_run(ppu, cycles);
+			apu_run(apu, cycles);
+		}
+	}
+	else if (emu->type == NTSC) {
+		while (!ppu->render) {
+			ppu_exec(ppu);
+			ppu_exec(ppu);
+			ppu_exec(ppu);
+			cpu_exec(cpu);
+			apu_exec(apu);
+		}
+	}
+	else {
 
-	if (!(emu->cpu = cpu_create(emu->bus))) {
-		ppu_destroy(emu->ppu);
-		bus_destroy(emu->bus);
-		gfx_destroy(emu->gfx);
-		free(emu);
-		return NULL;
+		// PAL
+		uint8_t check = 0;
+		while (!ppu->render) {
+			ppu_exec(ppu);
+			ppu_exec(ppu);
+			ppu_exec(ppu);
+			check++;
+			if(check == 5) {
+				// on the fifth run execute an extra ppu clock
+				// this produces 3.2 scanlines per cpu clock
+				ppu_exec(ppu);
+				check = 0;
+			}
+			cpu_exec(cpu);
+			apu_exec(apu);
+		}
 	}
+	ppu->render = 0;
+}
 
-	if (!(emu->apu = apu_create(emu->bus, emu->gfx))) {
-		cpu_destroy(emu->cpu);
-		ppu_destroy(emu->ppu);
-		bus_destroy(emu->bus);
-		gfx_destroy(emu->gfx);
-		free(emu);
-		return NULL;
+int emulator_set_run_ahead(emulator_t* emu, unsigned frames)
+{
+	if (frames && emu->ahead_state == NULL) {
+		emu->ahead_state = malloc(machine_state_size(emu->machine));
+		if (emu->ahead_state == NULL) {
+			LOG(ERROR, "Failed to allocate run-ahead state");
+			return -1;
+		}
 	}
+	emu->run_ahead = frames;
+	return 0;
+}
+
+void emulator_run_ahead(emulator_t* emu)
+{
+	if (!emu->run_ahead)
+		return;
 
-	bus_set_cpu(emu->bus, emu->cpu);
-	bus_set_ppu(emu->bus, emu->ppu);
-	bus_set_apu(emu->bus, emu->apu);
+	timerx_t timer = timerx_create(0);
+	timerx_mark_start(&timer);
 
-	emu->timer = timerx_create(emu->period);
-	emu->exit  = 0;
-	emu->pause = 0;
+	machine_save(emu->machine, emu->ahead_state);
+	apu_mute(emu->apu, 1);
+	for (unsigned i = 0; i < emu->run_ahead; i++)
+		emulator_run_frame(emu);
+	apu_mute(emu->apu, 0);
+	machine_restore(emu->machine, emu->ahead_state);
 
-	return emu;
+	timerx_mark_end(&timer);
+	emu->ahead_ms += timerx_get_diff(&timer);
+	emu->ahead_count++;
 }
 
-void emulator_exec(emulator_t* emu)
+int emulator_record_movie(emulator_t* emu, const char* path)
 {
-	gfx_t* gfx           = emu->gfx;
-	timerx_t* timer      = &emu->timer;
-	timerx_t frame_timer = timerx_create(emu->period);
-	snapshot_t* snapshot = snapshot_create(emu);
+	if (!(emu->movie = movie_create(path, emu->machine, emu->sync)))
+		return -1;
+	movie_keyframe(emu->movie, emu->machine);
+	LOG(INFO, "Recording movie to %s", path);
+	return 0;
+}
 
-	SDL_Event e;
-	timerx_mark_start(&frame_timer);
+int emulator_play_movie(emulator_t* emu, const char* path)
+{
+	if (!(emu->movie = movie_load(path, emu->machine)))
+		return -1;
+	emu->sync = emu->movie->sync;
+	movie_keyframe(emu->movie, emu->machine);
+	LOG(INFO, "Playing back %u frames of %s", emu->movie->frames, path);
+	return 0;
+}
 
-	while (!emu->exit) {
+int emulator_stop_movie(emulator_t* emu)
+{
+	movie_t* movie = emu->movie;
+	if (movie == NULL)
+		return 0;
 
-		// Reinitialize every loop because snapshots.
-		joypad_t* joy1 = &emu->bus->joy1;
-		joypad_t* joy2 = &emu->bus->joy2;
-		ppu_t* ppu     = emu->ppu;
-		cpu6502_t* cpu = emu->cpu;
-		apu_t* apu     = emu->apu;
+	int err = 0;
+	uint64_t checksum;
+	if (machine_checksum(emu->machine, &checksum)) {
+		LOG(ERROR, "Failed to checksum the machine's state");
+		err = -1;
+	} else if (movie->mode == MOVIE_RECORD) {
+		if (!(err = movie_save(movie, checksum)))
+			LOG(INFO, "Recorded %u frames to %s", movie->frames, movie->path);
+	} else if (movie->frame < movie->frames) {
+		LOG(INFO, "Stopped playback at frame %u of %u", movie->frame, movie->frames);
+	} else if (checksum != movie->checksum) {
+		LOG(ERROR, "Playback desynced: state after frame %u differs from the recording",
+		    movie->frames);
+		err = -1;
+	} else {
+		LOG(INFO, "Played back %u frames, matching the recording", movie->frames);
+		if (!movie->indexed)
+			movie_save_index(movie);
+	}
 
-		timerx_mark_start(timer);
+	movie_destroy(movie);
+	emu->movie = NULL;
+	return err;
+}
 
-		while (SDL_PollEvent(&e)) {
-			joypad_update(joy1, &e);
-			joypad_update(joy2, &e);
-			if ((joy1->status & 0xc) == 0xc ||
-			    (joy2->status & 0xc) == 0xc) {
-				emulator_reset(emu);
-			}
+uint8_t emulator_playing(emulator_t* emu)
+{ return emu->movie && emu->movie->mode == MOVIE_PLAY; }
 
-			switch (e.type) {
-			case SDL_KEYDOWN:
-				switch (e.key.keysym.sym) {
-				case SDLK_ESCAPE:
-					emu->exit = 1;
-					break;
-				case SDLK_AUDIOPLAY:
-				case SDLK_SPACE:
-					emu->pause ^= 1;
-					break;
-				case SDLK_F5:
-				        emulator_reset(emu);
-					break;
-				case SDLK_TAB:
-					snapshot_restore(snapshot, emu);
-					continue;
-				case SDLK_q:
-					snapshot_update(snapshot, emu);
-					continue;
-				default:
-					break;
-				}
-				break;
-			case SDL_QUIT:
-				emu->exit = 1;
-				break;
-			default:
-				if(e.key.keysym.sym == SDLK_AC_BACK
-				   || e.key.keysym.scancode == SDL_SCANCODE_AC_BACK) {
-					emu->exit = 1;
-					LOG(DEBUG, "Exiting emulator session");
-				}
-			}
-		}
+// movie_step is called before each frame while there is a movie. It
+// feeds the joypads from the movie when playing it back, or records
+// them, and whether the machine was reset, otherwise. It returns -1
+// once playback has reached the end of the movie, or if recording
+// failed.
+static int movie_step(emulator_t* emu)
+{
+	bus_data_t* data = emu->bus->data;
+	if (!emulator_playing(emu)) {
+		int err = movie_record(emu->movie, (movie_input_t){
+			.joy1  = data->joy1.status,
+			.joy2  = data->joy2.status,
+			.reset = emu->reset
+		});
+		emu->reset = 0;
+		return err;
+	}
 
-		// Trigger turbo events
-		if (ppu->frames % emu->turbo_skip == 0) {
-			joypad_trigger_turbo(joy1);
-			joypad_trigger_turbo(joy2);
-		}
+	movie_input_t input;
+	if (movie_play(emu->movie, &input))
+		return -1;
 
-		if (!emu->pause) {
-			// If ppu.render is set a frame is complete
-			if (emu->type == NTSC) {
-				while (!ppu->render) {
-					ppu_exec(ppu);
-					ppu_exec(ppu);
-					ppu_exec(ppu);
-					cpu_exec(cpu);
-					apu_exec(apu);
-				}
-			}
-			else {
-
-				// PAL
-				uint8_t check = 0;
-				while (!ppu->render) {
-					ppu_exec(ppu);
-					ppu_exec(ppu);
-					ppu_exec(ppu);
-					check++;
-					if(check == 5) {
-						// on the fifth run execute an extra ppu clock
-						// this produces 3.2 scanlines per cpu clock
-						ppu_exec(ppu);
-						check = 0;
-					}
-					cpu_exec(cpu);
-					apu_exec(apu);
-				}
-			}
-			gfx_render(gfx, ppu->screen);
-			ppu->render = 0;
-			apu_queue_audio(apu, gfx);
-			timerx_mark_end(timer);
-			timerx_adjusted_wait(timer);
-
-		} else {
-			timerx_wait(IDLE_SLEEP);
-		}
+	if (input.reset)
+		emulator_reset(emu);
+	data->joy1.status = input.joy1;
+	data->joy2.status = input.joy2;
+	return 0;
+}
+
+int emulator_seek_movie(emulator_t* emu, uint32_t frame)
+{
+	if (!emulator_playing(emu)) {
+		LOG(ERROR, "No movie is being played back");
+		return -1;
 	}
-	snapshot_destroy(snapshot);
-	timerx_mark_end(&frame_timer);
-	emu->time_diff = timerx_get_diff(&frame_timer);
+
+	movie_t* movie = emu->movie;
+	if (movie_seek(movie, emu->machine, frame))
+		return -1;
+	if (!movie->indexed)
+		LOG(INFO, "Movie has no index yet; emulating %u frames", frame - movie->frame);
+
+	// Catch up from the keyframe without sound.
+	timerx_t timer = timerx_create(0);
+	timerx_mark_start(&timer);
+	uint32_t from = movie->frame;
+	apu_mute(emu->apu, 1);
+	while (movie->frame < frame && !movie_step(emu)) {
+		emulator_run_frame(emu);
+		movie_keyframe(movie, emu->machine);
+	}
+	apu_mute(emu->apu, 0);
+	apu_discard_audio(emu->apu);
+	timerx_mark_end(&timer);
+
+	LOG(INFO, "Seeked to frame %u in %.2f ms (%u frames emulated)", frame,
+	    timerx_get_diff(&timer), frame - from);
+	return 0;
+}
+
+void emulator_step(emulator_t* emu)
+{
+	// Trigger turbo events. The joypad status of a movie being played
+	// back already has them.
+	if (emu->ppu->frames % emu->turbo_skip == 0 && !emulator_playing(emu)) {
+		joypad_trigger_turbo(&emu->bus->data->joy1);
+		joypad_trigger_turbo(&emu->bus->data->joy2);
+	}
+
+	// While rewinding, each frame is the one that follows the state
+	// stepped back to.
+	if (emu->rewinding)
+		rewind_step(emu->rewind);
+
+	// Once playback ends, the user takes over. A recording that has
+	// run out of memory is stopped, which reports that it was lost.
+	if (emu->movie && movie_step(emu))
+		emulator_stop_movie(emu);
+
+	emulator_run_frame(emu);
+	if (emu->movie)
+		movie_keyframe(emu->movie, emu->machine);
+	if (emu->rewind && !emu->rewinding)
+		rewind_capture(emu->rewind);
+	emulator_run_ahead(emu);
+}
+
+void emulator_exec_headless(emulator_t* emu)
+{
+	timerx_t timer = timerx_create(0);
+	timerx_mark_start(&timer);
+
+	while (!movie_step(emu)) {
+		emulator_run_frame(emu);
+		movie_keyframe(emu->movie, emu->machine);
+		emulator_run_ahead(emu);
+		apu_discard_audio(emu->apu);
+	}
+
+	timerx_mark_end(&timer);
+	emu->time_diff = timerx_get_diff(&timer);
+}
+
+int emulator_set_joypad(emulator_t* emu, uint8_t player, uint16_t buttons)
+{
+	if (player > 1) {
+		LOG(ERROR, "No joypad for player %u", player);
+		return -1;
+	}
+	joypad_t* joy = player ? &emu->bus->data->joy2 : &emu->bus->data->joy1;
+	joy->status = buttons;
+	return 0;
+}
+
+const uint8_t* emulator_screen(emulator_t* emu, const uint8_t** emphasis)
+{
+	if (emphasis)
+		*emphasis = emu->machine->emphasis;
+	return emu->machine->screen;
+}
+
+const int16_t* emulator_audio(emulator_t* emu, size_t* count)
+{ return apu_take_audio(emu->apu, count); }
+
+uint8_t* emulator_ram(emulator_t* emu)
+{ return emu->bus->data->ram; }
+
+const uint32_t* emulator_present_frame(emulator_t* emu)
+{
+	palette_convert_rgba(&emu->palette, emu->machine->screen, emu->machine->emphasis,
+		VISIBLE_DOTS, VISIBLE_SCANLINES, emu->frame);
+	return emu->frame;
 }
 
 void emulator_reset(emulator_t* emu)
@@ -185,17 +344,20 @@ void emulator_reset(emulator_t* emu)
 	cpu_reset(emu->cpu);
 	apu_reset(emu->apu);
 	ppu_reset(emu->ppu);
+	emu->reset = 1;
 }
 
 void emulator_destroy(emulator_t* emu)
 {
 	LOG(DEBUG, "Starting emulator clean up");
 
-	apu_destroy(emu->apu);
-	ppu_destroy(emu->ppu);
-	cpu_destroy(emu->cpu);
-	gfx_destroy(emu->gfx);
-	bus_destroy(emu->bus);
+	if (emu->rewind)
+		rewind_destroy(emu->rewind);
+	if (emu->movie)
+		movie_destroy(emu->movie);
+	free(emu->ahead_state);
+	machine_destroy(emu->machine);
+	free(emu->frame);
 	free(emu);
 
 	LOG(DEBUG, "Emulator session successfully terminated");
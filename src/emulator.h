@@ -7,7 +7,10 @@
 #include "bus.h"
 #include "audio/apu.h"
 #include "mapper.h"
-#include "gfx.h"
+#include "machine.h"
+#include "rewind.h"
+#include "movie.h"
+#include "palette.h"
 #include "timerx.h"
 
 // Frame rate in Hz.
@@ -19,32 +22,85 @@
 #define NTSC_TURBO_RATE 30
 #define PAL_TURBO_RATE  25
 
-// Sleep time when emulator is paused in milliseconds.
-#define IDLE_SLEEP 50
+// Most frames that can be emulated ahead of each frame shown.
+#define MAX_RUN_AHEAD 8
+
+// emu_sync enumerates the ways the CPU is kept in step with the PPU
+// and APU.
+enum emu_sync
+{
+	// Lock-step the PPU, CPU and APU one CPU cycle at a time.
+	SYNC_CYCLE = 0,
+
+	// Execute whole CPU instructions, then advance the PPU and APU
+	// by the number of cycles each instruction took.
+	SYNC_INSTR,
+
+	// Let the CPU run ahead, and only catch the PPU and APU up when
+	// one of their registers is accessed or when they are predicted
+	// to raise an interrupt or finish a frame.
+	SYNC_CATCHUP
+};
 
 // emulator_t tracks the state of the NES emulator. It encapsulates
-// all significant NES circuits (CPU, PPU, APU, BUS).
+// all significant NES circuits (CPU, PPU, APU, BUS), which live in
+// machine; cpu, ppu, apu and bus point into it. It has no window,
+// audio device or input of its own: those are left to its user (see
+// frontend.h).
 typedef struct
 {
+	machine_t* machine;
+
 	cpu6502_t* cpu;
 	ppu_t*     ppu;
 	apu_t*     apu;
 	bus_t*     bus;
 
+	// The machine's copy of the cartridge (see mapper_attach).
 	mapper_t* mapper;
-	gfx_t*    gfx;
+
+	// Path of the ROM file, next to which save states are stored.
+	// NULL if not known.
+	const char* path;
+
+	// History of states to rewind through, or NULL. While rewinding
+	// is set, each frame steps back through it instead of recording.
+	rewind_t* rewind;
+	uint8_t   rewinding;
+
+	// Frames emulated ahead of each frame shown (see
+	// emulator_run_ahead), the state they are undone to, and the
+	// time spent on them over ahead_count frames.
+	unsigned  run_ahead;
+	uint8_t*  ahead_state;
+	double    ahead_ms;
+	size_t    ahead_count;
+
+	// Movie being recorded or played back, or NULL. reset is set by
+	// emulator_reset, so that resets are recorded.
+	movie_t*  movie;
+	uint8_t   reset;
+
+	// The PPU's indexed frame converted to pixels for presentation.
+	palette_t palette;
+	uint32_t* frame;
+
+	// Time spent running the last session, in milliseconds.
 	double    time_diff;
-	uint8_t   exit;
-	uint8_t   pause;
-	timerx_t  timer;
 	uint64_t  period;
 	uint64_t  turbo_skip;
 
 	enum tv_system type;
+	enum emu_sync  sync;
 
 } emulator_t;
 
 
+// emulator_create creates an emulator for the given cartridge (see
+// mapper_from_file and mapper_from_memory), which must outlive it. The
+// cartridge's ROM is only read, so one mapper_t may be shared by any
+// number of emulators. It is driven by emulator_run_frame or
+// emulator_step.
 emulator_t* emulator_create(mapper_t* mapper);
 void emulator_destroy(emulator_t* emu);
 
@@ -52,8 +108,77 @@ void emulator_destroy(emulator_t* emu);
 // soft-resetting the NES).
 void emulator_reset(emulator_t* emu);
 
-// emulator_exec executes the emulator. It enters a loop that stops
-// when the user closes the window or exits the process.
-void emulator_exec(emulator_t* emu);
+// emulator_run_frame executes the NES circuits until the PPU has
+// completed a frame. It does not render, play audio or sleep.
+void emulator_run_frame(emulator_t* emu);
+
+// emulator_step runs the next frame of an interactive session: it
+// triggers turbo buttons, plays back or records emu->movie, steps back
+// through or records the rewind history, and runs ahead. Audio is left
+// for the caller to queue or discard.
+void emulator_step(emulator_t* emu);
+
+// emulator_set_run_ahead sets the number of frames emulated ahead of
+// each frame shown, or disables run-ahead if frames is 0. It returns 0
+// on success.
+int emulator_set_run_ahead(emulator_t* emu, unsigned frames);
+
+// emulator_run_ahead emulates emu->run_ahead frames past the current
+// one without sound, then returns the machine to the current frame,
+// leaving the picture of the last frame emulated on the screen. Input
+// read during those frames is the input of the current frame, so the
+// picture shows its effect that many frames sooner.
+void emulator_run_ahead(emulator_t* emu);
+
+// emulator_record_movie starts recording the input of every frame to
+// a movie at path, and emulator_play_movie plays the movie at path
+// back in place of the user's input, in the emu_sync mode it was
+// recorded with. Either must be called before the first frame. They
+// return 0 on success.
+int emulator_record_movie(emulator_t* emu, const char* path);
+int emulator_play_movie(emulator_t* emu, const char* path);
+
+// emulator_playing reports whether a movie is being played back.
+uint8_t emulator_playing(emulator_t* emu);
+
+// emulator_seek_movie moves playback of emu->movie to the given frame,
+// emulating at most MOVIE_KEYFRAME_INTERVAL frames if the movie has an
+// index. It returns 0 on success.
+int emulator_seek_movie(emulator_t* emu, uint32_t frame);
+
+// emulator_stop_movie writes a movie being recorded to its file, or
+// ends playback. Once the whole of a movie has been played back, it
+// checks that the machine's state matches the one recorded. It returns
+// 0, or -1 if the movie could not be written or playback desynced.
+int emulator_stop_movie(emulator_t* emu);
+
+// emulator_set_joypad sets the buttons held on joypad player (0 or 1)
+// to buttons, a mask of the BUTTON_A to RIGHT bits (see joypad.h). It
+// returns 0, or -1 and leaves the joypads alone if there is no such player.
+int emulator_set_joypad(emulator_t* emu, uint8_t player, uint16_t buttons);
+
+// emulator_screen returns the last frame completed by the PPU, as
+// VISIBLE_DOTS x VISIBLE_SCANLINES colour indices, and sets emphasis,
+// if not NULL, to the emphasis bits of each line (see palette.h). They
+// are the machine's own buffers, overwritten by the next frame.
+const uint8_t* emulator_screen(emulator_t* emu, const uint8_t** emphasis);
+
+// emulator_audio returns the samples produced since the last call and
+// sets count to their number (see apu_take_audio). They are mono,
+// signed 16-bit and SAMPLING_FREQUENCY Hz, and stay valid until the
+// next frame is run.
+const int16_t* emulator_audio(emulator_t* emu, size_t* count);
+
+// emulator_ram returns the console's internal RAM (RAM_SIZE bytes).
+// Writes to it are seen by the running game.
+uint8_t* emulator_ram(emulator_t* emu);
+
+// emulator_present_frame converts the PPU's indexed frame to ABGR8888
+// pixels in emu->frame and returns it.
+const uint32_t* emulator_present_frame(emulator_t* emu);
+
+// emulator_exec_headless plays emu->movie back to its end as fast as
+// possible, without presenting frames or playing audio.
+void emulator_exec_headless(emulator_t* emu);
 
 #endif // NES_TOOLS_EMULATOR_H
@@ -1,4 +1,4 @@
-unsigned char font_data[31035] =
+const unsigned char font_data[31035] =
 {
 	0x00,0x01,0x00,0x00,0x00,0x0F,0x00,0x80,
 	0x00,0x03,0x00,0x70,0x44,0x53,0x49,0x47,
@@ -0,0 +1,322 @@
+#include "frontend.h"
+#include "snapshot.h"
+#include "triplebuf.h"
+#include "input.h"
+
+frontend_t* frontend_create(emulator_t* emu)
+{
+	frontend_t* fe = malloc(sizeof(frontend_t));
+	if (fe == NULL) {
+		LOG(ERROR, "Failed to allocate frontend");
+		return NULL;
+	}
+
+	if (!(fe->gfx = gfx_create(256, 240, 2))) {
+		free(fe);
+		return NULL;
+	}
+	fe->gfx->screen_width = -1;
+	fe->gfx->screen_height = -1;
+
+	if (gfx_open_audio(fe->gfx, apu_output(emu->apu)->ring)) {
+		gfx_destroy(fe->gfx);
+		free(fe);
+		return NULL;
+	}
+
+	fe->emu      = emu;
+	fe->exit     = 0;
+	fe->pause    = 0;
+	fe->uncapped = 0;
+	fe->timer    = timerx_create(emu->period);
+	return fe;
+}
+
+void frontend_destroy(frontend_t* fe)
+{
+	gfx_destroy(fe->gfx);
+	free(fe);
+}
+
+// update_joypad updates the status of the joypad according to an SDL
+// keyboard event.
+static void update_joypad(joypad_t* joy, SDL_Event* event)
+{
+	uint16_t key = 0;
+	switch (event->key.keysym.sym) {
+	case SDLK_RIGHT:
+		key = RIGHT;
+		break;
+        case SDLK_LEFT:
+		key = LEFT;
+		break;
+        case SDLK_DOWN:
+		key = DOWN;
+		break;
+        case SDLK_UP:
+		key = UP;
+		break;
+        case SDLK_RETURN:
+		key = START;
+		break;
+        case SDLK_RSHIFT:
+		key = SELECT;
+		break;
+        case SDLK_j:
+		key = BUTTON_A;
+            break;
+        case SDLK_k:
+		key = BUTTON_B;
+		break;
+        case SDLK_l:
+		key = TURBO_B;
+		break;
+        case SDLK_h:
+		key = TURBO_A;
+		break;
+	}
+
+	if (event->type == SDL_KEYUP) {
+		joy->status &= ~key;
+		if (key == TURBO_A)
+			joy->status &= ~BUTTON_A;
+
+		if (key == TURBO_B)
+			joy->status &= ~BUTTON_B;
+
+		return;
+	}
+
+	if (event->type == SDL_KEYDOWN) {
+		joy->status |= key;
+		if (key == TURBO_A)
+			joy->status |= BUTTON_A;
+
+		if (key == TURBO_B)
+			joy->status |= BUTTON_B;
+
+		return;
+	}
+}
+
+// session_t is shared by the SDL thread and the core thread while
+// frontend_exec runs. The core publishes frames to the SDL thread, and
+// the SDL thread sends it input.
+typedef struct
+{
+	input_queue_t input;
+	frontend_t*   fe;
+	triplebuf_t*  frames;
+
+} session_t;
+
+// handle_input applies an event sent by the SDL thread.
+static void handle_input(frontend_t* fe, input_event_t* event)
+{
+	emulator_t* emu = fe->emu;
+	switch (event->cmd) {
+	case INPUT_JOYPAD:
+		emu->bus->data->joy1.status = event->joy1;
+		emu->bus->data->joy2.status = event->joy2;
+		break;
+	case INPUT_RESET:
+		if (!emulator_playing(emu))
+			emulator_reset(emu);
+		break;
+	case INPUT_PAUSE:
+		fe->pause ^= 1;
+		break;
+	case INPUT_SAVE:
+		snapshot_save_slot(emu, event->slot);
+		break;
+	case INPUT_LOAD:
+		// A movie only holds input, so the state cannot change
+		// under it.
+		if (emu->movie)
+			LOG(ERROR, "Cannot load a state while a movie is recorded or played");
+		else
+			snapshot_load_slot(emu, event->slot);
+		break;
+	case INPUT_REWIND_START:
+		emu->rewinding = (emu->rewind != NULL && emu->movie == NULL);
+		break;
+	case INPUT_REWIND_STOP:
+		emu->rewinding = 0;
+		break;
+	case INPUT_EXIT:
+		fe->exit = 1;
+		LOG(DEBUG, "Exiting emulator session");
+		break;
+	}
+}
+
+// run_core is the core thread: it runs and paces the emulator, and
+// publishes every completed frame.
+static int run_core(void* data)
+{
+	session_t* session   = data;
+	frontend_t* fe       = session->fe;
+	emulator_t* emu      = fe->emu;
+	timerx_t* timer      = &fe->timer;
+	input_event_t event;
+
+	while (!fe->exit) {
+		timerx_mark_start(timer);
+
+		while (input_queue_pop(&session->input, &event))
+			handle_input(fe, &event);
+
+		if (fe->exit)
+			break;
+
+		if (!fe->pause) {
+			emulator_step(emu);
+
+			frame_t* frame = triplebuf_back(session->frames);
+			memcpy(frame->screen, ppu_screen(emu->ppu), sizeof(frame->screen));
+			memcpy(frame->emphasis, ppu_emphasis(emu->ppu), sizeof(frame->emphasis));
+			triplebuf_publish(session->frames);
+
+			// Frames shown while rewinding are not heard.
+			if (emu->rewinding || fe->uncapped) {
+				apu_discard_audio(emu->apu);
+			} else {
+				apu_queue_audio(emu->apu);
+				gfx_play_audio(fe->gfx, apu_output(emu->apu)->ring);
+			}
+			timerx_mark_end(timer);
+			if (!fe->uncapped)
+				timerx_adjusted_wait(timer);
+
+		} else {
+			timerx_wait(IDLE_SLEEP);
+		}
+	}
+	return 0;
+}
+
+// send forwards an event to the core thread, waiting for room in the
+// queue if needed.
+static void send(session_t* session, enum input_cmd cmd,
+	joypad_t* joy1, joypad_t* joy2, uint8_t slot)
+{
+	input_event_t event = {
+		.cmd  = cmd,
+		.joy1 = joy1->status,
+		.joy2 = joy2->status,
+		.slot = slot
+	};
+	while (!input_queue_push(&session->input, event))
+		timerx_wait(1);
+}
+
+void frontend_exec(frontend_t* fe)
+{
+	emulator_t* emu      = fe->emu;
+	timerx_t frame_timer = timerx_create(emu->period);
+
+	session_t* session = aligned_alloc(_Alignof(session_t), sizeof(session_t));
+	if (session == NULL || !(session->frames = triplebuf_create())) {
+		LOG(ERROR, "Failed to start emulator session");
+		free(session);
+		return;
+	}
+	session->fe = fe;
+	input_queue_init(&session->input);
+
+	SDL_Thread* core = SDL_CreateThread(run_core, "core", session);
+	if (core == NULL) {
+		LOG(ERROR, "SDL error: %s", SDL_GetError());
+		triplebuf_destroy(session->frames);
+		free(session);
+		return;
+	}
+
+	// The SDL thread keeps its own view of the joypads and sends the
+	// core their full state whenever it changes.
+	joypad_t joy1 = joypad_create(0);
+	joypad_t joy2 = joypad_create(1);
+	uint8_t running = 1;
+	uint8_t slot = 0;
+
+	SDL_Event e;
+	timerx_mark_start(&frame_timer);
+
+	while (running) {
+		while (SDL_PollEvent(&e)) {
+			if (e.type == SDL_KEYUP && e.key.keysym.sym == SDLK_BACKSPACE)
+				send(session, INPUT_REWIND_STOP, &joy1, &joy2, slot);
+
+			uint16_t status1 = joy1.status;
+			uint16_t status2 = joy2.status;
+			update_joypad(&joy1, &e);
+			update_joypad(&joy2, &e);
+			if (joy1.status != status1 || joy2.status != status2)
+				send(session, INPUT_JOYPAD, &joy1, &joy2, slot);
+
+			if ((joy1.status & 0xc) == 0xc ||
+			    (joy2.status & 0xc) == 0xc) {
+				send(session, INPUT_RESET, &joy1, &joy2, slot);
+			}
+
+			switch (e.type) {
+			case SDL_KEYDOWN:
+				switch (e.key.keysym.sym) {
+				case SDLK_ESCAPE:
+					running = 0;
+					break;
+				case SDLK_AUDIOPLAY:
+				case SDLK_SPACE:
+					send(session, INPUT_PAUSE, &joy1, &joy2, slot);
+					break;
+				case SDLK_F5:
+					send(session, INPUT_RESET, &joy1, &joy2, slot);
+					break;
+				case SDLK_TAB:
+					send(session, INPUT_LOAD, &joy1, &joy2, slot);
+					continue;
+				case SDLK_q:
+					send(session, INPUT_SAVE, &joy1, &joy2, slot);
+					continue;
+				case SDLK_BACKSPACE:
+					if (!e.key.repeat)
+						send(session, INPUT_REWIND_START, &joy1, &joy2, slot);
+					continue;
+				default:
+					if (e.key.keysym.sym >= SDLK_0 && e.key.keysym.sym <= SDLK_9) {
+						slot = e.key.keysym.sym - SDLK_0;
+						LOG(INFO, "Save state slot %d", slot);
+					}
+					break;
+				}
+				break;
+			case SDL_QUIT:
+				running = 0;
+				break;
+			default:
+				if(e.key.keysym.sym == SDLK_AC_BACK
+				   || e.key.keysym.scancode == SDL_SCANCODE_AC_BACK) {
+					running = 0;
+				}
+			}
+		}
+
+		// Present the newest frame, if the core has completed one.
+		const frame_t* frame = triplebuf_latest(session->frames);
+		if (frame != NULL) {
+			palette_convert_rgba(&emu->palette, frame->screen, frame->emphasis,
+				VISIBLE_DOTS, VISIBLE_SCANLINES, emu->frame);
+			gfx_render(fe->gfx, emu->frame);
+		} else {
+			timerx_wait(1);
+		}
+	}
+
+	send(session, INPUT_EXIT, &joy1, &joy2, slot);
+	SDL_WaitThread(core, NULL);
+
+	triplebuf_destroy(session->frames);
+	free(session);
+	timerx_mark_end(&frame_timer);
+	emu->time_diff = timerx_get_diff(&frame_timer);
+}
@@ -0,0 +1,37 @@
+#ifndef NES_TOOLS_FRONTEND_H
+#define NES_TOOLS_FRONTEND_H
+
+#include "system.h"
+#include "emulator.h"
+#include "gfx.h"
+#include "timerx.h"
+
+// Sleep time when emulator is paused in milliseconds.
+#define IDLE_SLEEP 50
+
+// frontend_t runs an emulator interactively: it presents its frames in
+// an SDL window, plays its audio and feeds it keyboard input.
+typedef struct
+{
+	emulator_t* emu;
+	gfx_t*      gfx;
+
+	uint8_t  exit;
+	uint8_t  pause;
+	uint8_t  uncapped;
+	timerx_t timer;
+
+} frontend_t;
+
+// frontend_create opens a window and an audio device for emu. SDL must
+// have been set up with gfx_init. frontend_destroy closes them, and
+// must be called before emu is destroyed.
+frontend_t* frontend_create(emulator_t* emu);
+void frontend_destroy(frontend_t* fe);
+
+// frontend_exec executes the emulator. It enters a loop that stops
+// when the user closes the window or exits the process, and sets
+// emu->time_diff to the time it ran for.
+void frontend_exec(frontend_t* fe);
+
+#endif // NES_TOOLS_FRONTEND_H
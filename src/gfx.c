@@ -1,30 +1,42 @@
 #include "gfx.h"
 
 // see: font.c
-extern unsigned char font_data[31035];
+extern const unsigned char font_data[31035];
 
-gfx_t* gfx_create(int width, int height, float scale)
+int gfx_init(void)
 {
 	if (SDL_Init(SDL_INIT_EVERYTHING) == -1) {
 		LOG(ERROR, "SDL error: %s", SDL_GetError());
-		return NULL;
+		return -1;
 	}
 	if (TTF_Init() == -1) {
 		LOG(ERROR, "SDL error: %s", TTF_GetError());
 		SDL_Quit();
-		return NULL;
+		return -1;
 	}
-	SDL_RWops* rw = SDL_RWFromMem(font_data, sizeof(font_data));
+	return 0;
+}
+
+void gfx_quit(void)
+{
+	TTF_Quit();
+	SDL_Quit();
+}
+
+gfx_t* gfx_create(int width, int height, float scale)
+{
+	SDL_RWops* rw = SDL_RWFromConstMem(font_data, sizeof(font_data));
 	gfx_t* gfx = malloc(sizeof(gfx_t));
 	gfx->width  = width;
 	gfx->height = height;
 	gfx->scale  = scale;
+	gfx->audio_device = 0;
+	gfx->audio_samples = 0;
+	gfx->audio_start = 0;
 	if (!(gfx->font = TTF_OpenFontRW(rw, 1, 11))) {
 		LOG(ERROR, "SDL error: %s", SDL_GetError());
 		SDL_FreeRW(rw);
 		free(gfx);
-		TTF_Quit();
-		SDL_Quit();
 		return NULL;
 	}
 	gfx->window = SDL_CreateWindow(
@@ -43,8 +55,6 @@ gfx_t* gfx_create(int width, int height, float scale)
 		SDL_FreeRW(rw);
 		TTF_CloseFont(gfx->font);
 		free(gfx);
-		TTF_Quit();
-		SDL_Quit();
 		return NULL;
 	}
 	SDL_SetWindowMinimumSize(gfx->window, gfx->width, gfx->height);
@@ -55,8 +65,6 @@ gfx_t* gfx_create(int width, int height, float scale)
 		TTF_CloseFont(gfx->font);
 		SDL_DestroyWindow(gfx->window);
 		free(gfx);
-		TTF_Quit();
-		SDL_Quit();
 		return NULL;
 	}
 	SDL_RenderSetLogicalSize(gfx->renderer, gfx->width, gfx->height);
@@ -76,8 +84,6 @@ gfx_t* gfx_create(int width, int height, float scale)
 		SDL_DestroyWindow(gfx->window);
 		SDL_DestroyRenderer(gfx->renderer);
 		free(gfx);
-		TTF_Quit();
-		SDL_Quit();
 		return NULL;
 	}
 	SDL_SetRenderDrawColor(gfx->renderer, 0, 0, 0, 255);
@@ -88,13 +94,15 @@ gfx_t* gfx_create(int width, int height, float scale)
 
 void gfx_destroy(gfx_t* gfx)
 {
+	if (!gfx) return;
+
+	// Closing the device waits for the callback, which reads the ring.
+	if (gfx->audio_device)
+		SDL_CloseAudioDevice(gfx->audio_device);
 	TTF_CloseFont(gfx->font);
-	TTF_Quit();
 	SDL_DestroyTexture(gfx->texture);
 	SDL_DestroyRenderer(gfx->renderer);
 	SDL_DestroyWindow(gfx->window);
-	SDL_CloseAudioDevice(gfx->audio_device);
-	SDL_Quit();
 	free(gfx);
 }
 
@@ -106,3 +114,48 @@ void gfx_render(gfx_t* gfx, const uint32_t* buffer)
 	SDL_SetRenderDrawColor(gfx->renderer, 0, 0, 0, 255);
 	SDL_RenderPresent(gfx->renderer);
 }
+
+// audio_callback runs on SDL's audio thread and pulls samples from
+// the ring.
+static void audio_callback(void* userdata, Uint8* stream, int len)
+{
+	ring_read(userdata, (int16_t*)stream, len / sizeof(int16_t));
+}
+
+int gfx_open_audio(gfx_t* gfx, ring_t* ring)
+{
+	SDL_AudioSpec want, have;
+	SDL_zero(want);
+
+	// Set the audio format.
+	want.freq   = SAMPLING_FREQUENCY;
+	want.format = AUDIO_S16SYS;
+
+	want.channels = 1;
+	want.samples  = DEVICE_BUFF_SIZE;
+	want.callback = audio_callback;
+	want.userdata = ring;
+	want.silence  = 0;
+
+	gfx->audio_device = SDL_OpenAudioDevice(NULL, 0, &want, &have, 0);
+	if (gfx->audio_device == 0) {
+		LOG(ERROR, "SDL error: %s", SDL_GetError());
+		return -1;
+	}
+	gfx->audio_samples = have.samples;
+	gfx->audio_start = 0;
+	SDL_PauseAudioDevice(gfx->audio_device, 1);
+	return 0;
+}
+
+void gfx_play_audio(gfx_t* gfx, ring_t* ring)
+{
+	if (!gfx->audio_start) {
+		if (ring_fill(ring) < NOMINAL_RING_FILL)
+			return;
+
+		SDL_PauseAudioDevice(gfx->audio_device, 0);
+		gfx->audio_start = 1;
+	}
+	ring_record_latency(ring, gfx->audio_samples);
+}
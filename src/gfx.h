@@ -2,8 +2,17 @@
 #define NES_TOOLS_GFX_H
 
 #include "system.h"
+#include "audio/audio.h"
+#include "audio/ring.h"
 
-// gfx_t interfaces the SDL window/renderer.
+#if defined _WIN32 || defined __CYGWIN__
+#define SDL_MAIN_HANDLED
+#endif
+
+#include <SDL.h>
+#include <SDL_ttf.h>
+
+// gfx_t interfaces the SDL window/renderer and audio device.
 typedef struct
 {
 	// Window metadata.
@@ -21,8 +30,20 @@ typedef struct
 	TTF_Font*         font;
 	SDL_Rect          dest;
 
+	// Samples the audio device pulls at a time, and whether it has
+	// started playing.
+	size_t  audio_samples;
+	uint8_t audio_start;
+
 } gfx_t;
 
+// gfx_init initializes SDL and SDL_ttf for the whole process, and
+// gfx_quit shuts them down. gfx_init must be called from the main
+// thread before any gfx_t is created, and gfx_quit once all of them
+// have been destroyed. gfx_init returns 0 on success.
+int gfx_init(void);
+void gfx_quit(void);
+
 // gfx_create allocates a new gfx_t, creating a window with the
 // specified width, height, and scaling factor.
 gfx_t* gfx_create(int width, int height, float scale);
@@ -31,4 +52,15 @@ void gfx_destroy(gfx_t* gfx);
 // gfx_render writes the texture stored in buffer to the screen.
 void gfx_render(gfx_t* gfx, const uint32_t* buffer);
 
+// gfx_open_audio opens an audio device, paused, that plays the samples
+// published to ring. It returns 0 on success. The device is closed by
+// gfx_destroy, which must be called before ring is destroyed.
+int gfx_open_audio(gfx_t* gfx, ring_t* ring);
+
+// gfx_play_audio is called after samples are published to the ring.
+// It starts the device once the ring holds NOMINAL_RING_FILL samples,
+// to prevent early onset underruns, then records the latency of the
+// samples published.
+void gfx_play_audio(gfx_t* gfx, ring_t* ring);
+
 #endif // NES_TOOLS_GFX_H
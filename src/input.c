@@ -0,0 +1,31 @@
+#include "input.h"
+
+void input_queue_init(input_queue_t* queue)
+{
+	atomic_init(&queue->head, 0);
+	atomic_init(&queue->tail, 0);
+}
+
+int input_queue_push(input_queue_t* queue, input_event_t event)
+{
+	size_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+	size_t head = atomic_load_explicit(&queue->head, memory_order_acquire);
+	if (tail - head == INPUT_QUEUE_SIZE)
+		return 0;
+
+	queue->events[tail & (INPUT_QUEUE_SIZE - 1)] = event;
+	atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+	return 1;
+}
+
+int input_queue_pop(input_queue_t* queue, input_event_t* event)
+{
+	size_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+	size_t tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+	if (head == tail)
+		return 0;
+
+	*event = queue->events[head & (INPUT_QUEUE_SIZE - 1)];
+	atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+	return 1;
+}
@@ -0,0 +1,59 @@
+#ifndef NES_TOOLS_INPUT_H
+#define NES_TOOLS_INPUT_H
+
+#include <stdatomic.h>
+
+#include "system.h"
+
+// Capacity of input_queue_t. Must be a power of two.
+#define INPUT_QUEUE_SIZE 64
+
+// input_cmd enumerates the requests the SDL thread sends to the
+// emulator core.
+enum input_cmd
+{
+	// Set both joypads to input_event_t.joy1/joy2.
+	INPUT_JOYPAD = 0,
+	INPUT_RESET,
+	INPUT_PAUSE,
+	// Save the state to, or load it from, slot input_event_t.slot.
+	INPUT_SAVE,
+	INPUT_LOAD,
+	// Start and stop stepping back through the rewind history.
+	INPUT_REWIND_START,
+	INPUT_REWIND_STOP,
+	INPUT_EXIT
+};
+
+// input_event_t is a single request to the emulator core.
+typedef struct
+{
+	enum input_cmd cmd;
+	uint16_t joy1;
+	uint16_t joy2;
+	uint8_t  slot;
+
+} input_event_t;
+
+// input_queue_t is a lock-free single-producer, single-consumer ring
+// of input events. head and tail only ever increase; they are kept on
+// separate cache lines so that the two threads do not share one.
+typedef struct
+{
+	input_event_t events[INPUT_QUEUE_SIZE];
+	_Alignas(64) atomic_size_t head;
+	_Alignas(64) atomic_size_t tail;
+
+} input_queue_t;
+
+// input_queue_init empties the queue.
+void input_queue_init(input_queue_t* queue);
+
+// input_queue_push appends an event. It returns 0 if the queue is full.
+int input_queue_push(input_queue_t* queue, input_event_t event);
+
+// input_queue_pop removes the oldest event into event. It returns 0 if
+// the queue is empty.
+int input_queue_pop(input_queue_t* queue, input_event_t* event);
+
+#endif // NES_TOOLS_INPUT_H
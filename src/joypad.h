@@ -41,10 +41,6 @@ uint8_t joypad_read(joypad_t* joy);
 // main memory (address 0x4016).
 void joypad_write(joypad_t* joy, uint8_t data);
 
-// joypad_update updates the status of the joypad according to an SDL
-// keyboard event.
-void joypad_update(joypad_t* joy, SDL_Event* event);
-
 // joypad_trigger_turbo triggers the turbo button.
 void joypad_trigger_turbo(joypad_t* joy);
 
@@ -1,30 +1,38 @@
 #include "log.h"
 
+// Longest line LOG writes; longer messages are truncated.
+#define LOG_LINE_SIZE 1024
+
 void LOG(enum log_level level, const char* fmt, ...)
 {
 	if (level < LOGLEVEL)
 		return;
 
+	const char* prefix;
 	switch (level) {
 	case INFO:
-		printf("INFO > ");
+		prefix = "INFO > ";
 		break;
 	case DEBUG:
-		printf("DEBUG > ");
+		prefix = "DEBUG > ";
 		break;
 	case ERROR:
-		printf("ERROR > ");
+		prefix = "ERROR > ";
 		break;
 	case WARN:
-		printf("WARN > ");
+		prefix = "WARN > ";
 		break;
 	default:
-		printf("LOG > ");
+		prefix = "LOG > ";
 	}
+
+	// The line is written with a single call, so that lines logged by
+	// emulators on different threads do not interleave.
+	char line[LOG_LINE_SIZE];
 	va_list ap;
 	va_start(ap, fmt);
-	vprintf(fmt, ap);
+	vsnprintf(line, sizeof(line), fmt, ap);
 	va_end(ap);
-	printf("\n");
+	printf("%s%s\n", prefix, line);
 	fflush(stdout);
 }
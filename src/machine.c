@@ -0,0 +1,97 @@
+#include "machine.h"
+
+machine_t* machine_create(mapper_t* mapper)
+{
+	machine_t* machine = aligned_alloc(_Alignof(machine_t), sizeof(machine_t));
+	if (machine == NULL) {
+		LOG(ERROR, "Failed to allocate machine");
+		return NULL;
+	}
+	memset(machine, 0, sizeof(machine_t));
+
+	machine_state_t* state = &machine->state;
+	if (mapper_attach(&machine->cart, mapper, state->prg_ram, state->chr_ram)) {
+		free(machine);
+		return NULL;
+	}
+	if (apu_output_init(&machine->audio, mapper->type)) {
+		mapper_detach(&machine->cart);
+		free(machine);
+		return NULL;
+	}
+
+	// The bus comes first: the other circuits are reached through it.
+	bus_init(&machine->bus, &machine->cart, &state->bus);
+	bus_set_cpu(&machine->bus, &state->cpu);
+	bus_set_ppu(&machine->bus, &state->ppu);
+	bus_set_apu(&machine->bus, &state->apu);
+
+	ppu_init(&state->ppu);
+	cpu_init(&state->cpu);
+	apu_init(&state->apu);
+
+	return machine;
+}
+
+void machine_destroy(machine_t* machine)
+{
+	apu_output_free(&machine->audio);
+	mapper_detach(&machine->cart);
+	free(machine);
+}
+
+size_t machine_state_size(machine_t* machine)
+{
+	if (machine->bus.mapper->chr_ram_size)
+		return sizeof(machine_state_t);
+	return offsetof(machine_state_t, chr_ram);
+}
+
+void machine_save(machine_t* machine, void* out)
+{ memcpy(out, &machine->state, machine_state_size(machine)); }
+
+void machine_restore(machine_t* machine, const void* in)
+{
+	mapper_t* mapper = machine->bus.mapper;
+	if (!mapper->chr_ram_size) {
+		memcpy(&machine->state, in, machine_state_size(machine));
+		return;
+	}
+
+	// The decoded tiles are a cache of CHR RAM, which seldom changes
+	// between states: only the tiles that differ are decoded again.
+	memcpy(&machine->state, in, offsetof(machine_state_t, chr_ram));
+	mapper_update_chr(mapper, ((const machine_state_t*)in)->chr_ram);
+}
+
+int machine_serialize(machine_t* machine, state_t* state)
+{
+	machine_state_t* s = &machine->state;
+	state_reset(state);
+	cpu_save(&s->cpu, state);
+	ppu_save(&s->ppu, state);
+	apu_save(&s->apu, state);
+	bus_save(&machine->bus, state);
+	mapper_save(&machine->cart, state);
+	return state->error ? -1 : 0;
+}
+
+int machine_checksum(machine_t* machine, uint64_t* checksum)
+{
+	state_t state;
+	state_init(&state);
+	if (machine_serialize(machine, &state)) {
+		state_free(&state);
+		return -1;
+	}
+
+	uint64_t hash = 0xcbf29ce484222325;
+	for (size_t i = 0; i < state.len; i++) {
+		hash ^= state.data[i];
+		hash *= 0x100000001b3;
+	}
+	state_free(&state);
+
+	*checksum = hash;
+	return 0;
+}
@@ -0,0 +1,101 @@
+#ifndef NES_TOOLS_MACHINE_H
+#define NES_TOOLS_MACHINE_H
+
+#include <stddef.h>
+
+#include "system.h"
+#include "cpu6502.h"
+#include "ppu.h"
+#include "bus.h"
+#include "audio/apu.h"
+#include "mapper.h"
+#include "state.h"
+
+// machine_state_t is all of the mutable state of an NES: the CPU, PPU
+// and APU, internal RAM and the cartridge's RAM. It holds no pointers,
+// so it can be copied as a whole and moved between machines running
+// the same ROM. CHR RAM comes last and is left out of copies when the
+// cartridge has CHR ROM (see machine_state_size).
+typedef struct
+{
+	_Alignas(64) cpu6502_t   cpu;
+	_Alignas(64) ppu_t       ppu;
+	_Alignas(64) apu_t       apu;
+	_Alignas(64) bus_data_t  bus;
+	_Alignas(64) uint8_t     prg_ram[PRG_RAM_SIZE];
+	_Alignas(64) uint8_t     chr_ram[CHR_RAM_SIZE];
+
+} machine_state_t;
+
+// machine_t is an NES: its state, and the wiring that connects the
+// state to the cartridge and to the outside (page tables, the frame
+// being drawn, audio output). The wiring is set up once by
+// machine_create and is never copied.
+typedef struct machine_t
+{
+	bus_t        bus;
+	mapper_t     cart;
+	apu_output_t audio;
+
+	// The frame being drawn by the PPU: colour indices (0-63), and the
+	// emphasis bits of PPU_MASK each line was drawn with. See palette.h.
+	uint8_t      screen[VISIBLE_SCANLINES * VISIBLE_DOTS];
+	uint8_t      emphasis[VISIBLE_SCANLINES];
+
+	machine_state_t state;
+
+} machine_t;
+
+// machine_create allocates a machine for the given cartridge, powered
+// on. The ROM in mapper is shared; the machine plugs in its own copy
+// (see mapper_attach). Its audio output is not played (see
+// apu_output_init).
+machine_t* machine_create(mapper_t* mapper);
+void machine_destroy(machine_t* machine);
+
+// machine_state_size returns the number of bytes of machine->state
+// that make up its state.
+size_t machine_state_size(machine_t* machine);
+
+// machine_save copies the machine's state (machine_state_size bytes)
+// to out, and machine_restore copies it back. States may be restored
+// into any machine running the same ROM.
+void machine_save(machine_t* machine, void* out);
+void machine_restore(machine_t* machine, const void* in);
+
+// machine_serialize writes the state of every component of the
+// machine into state, replacing its contents. Unlike machine_save, the
+// result does not depend on how the compiler lays out machine_state_t.
+// It returns 0 on success, or -1 if memory ran out.
+int machine_serialize(machine_t* machine, state_t* state);
+
+// machine_checksum sets checksum to a 64-bit FNV-1a hash of the
+// machine's serialized state (see machine_serialize). Machines that
+// were given the same input from power-on have the same checksum, on
+// any build. It returns 0 on success.
+int machine_checksum(machine_t* machine, uint64_t* checksum);
+
+// The components of a machine find each other, and the wiring, at
+// fixed offsets from themselves.
+#define MACHINE_OF(ptr, member) \
+	((machine_t*)((char*)(ptr) - offsetof(machine_t, member)))
+
+static inline bus_t* cpu_bus(cpu6502_t* cpu)
+{ return &MACHINE_OF(cpu, state.cpu)->bus; }
+
+static inline bus_t* ppu_bus(ppu_t* ppu)
+{ return &MACHINE_OF(ppu, state.ppu)->bus; }
+
+static inline uint8_t* ppu_screen(ppu_t* ppu)
+{ return MACHINE_OF(ppu, state.ppu)->screen; }
+
+static inline uint8_t* ppu_emphasis(ppu_t* ppu)
+{ return MACHINE_OF(ppu, state.ppu)->emphasis; }
+
+static inline bus_t* apu_bus(apu_t* apu)
+{ return &MACHINE_OF(apu, state.apu)->bus; }
+
+static inline apu_output_t* apu_output(apu_t* apu)
+{ return &MACHINE_OF(apu, state.apu)->audio; }
+
+#endif // NES_TOOLS_MACHINE_H
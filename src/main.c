@@ -1,6 +1,23 @@
+#include <errno.h>
+#include <limits.h>
+
 #include "system.h"
 #include "mapper.h"
 #include "emulator.h"
+#include "frontend.h"
+#include "batch.h"
+
+// Number of frames emulated by "bench" when --frames is not given.
+#define BENCH_FRAMES 1800
+
+// Band-limited step buffer frames resampled per round, and rounds per
+// quality level, by "bench --quality all".
+#define RESAMPLER_FRAMES 100000
+#define RESAMPLER_ROUNDS 3
+
+// Length of the pseudo-random step pattern replayed by the resampler
+// benchmark.
+#define RESAMPLER_STEPS  4096
 
 const char* doc_str =
 	"nes-tools is an NES emulator.\n\n"
@@ -8,9 +25,81 @@ const char* doc_str =
 	"\tnes-tools <command> [arguments]\n\n"
 	"The commands are:\n\n"
 	"\trun\tRun the emulator on a given ROM\n"
+	"\tbench\tMeasure emulation speed on a given ROM\n"
 	"\tversion\tOutput the nes-tools version\n\n"
 	"Use \"nes-tools help <command>\" for more information about a command.\n";
 
+// parse_sync parses the argument of a --sync option.
+static enum emu_sync parse_sync(const char* cmd, const char* name)
+{
+	if (!strcmp(name, "cycle"))
+		return SYNC_CYCLE;
+
+	if (!strcmp(name, "instr"))
+		return SYNC_INSTR;
+
+	if (!strcmp(name, "catchup"))
+		return SYNC_CATCHUP;
+
+	LOG(ERROR, "unrecognized sync mode: %s", name);
+	printf("Run '%s help %s' for usage.\n", PACKAGE_NAME, cmd);
+	exit(EXIT_FAILURE);
+}
+
+// Names of the audio_quality levels accepted by --quality.
+static const char* quality_names[] =
+{
+	[AUDIO_OFF]    = "off",
+	[AUDIO_LINEAR] = "linear",
+	[AUDIO_SINC8]  = "sinc8",
+	[AUDIO_SINC16] = "sinc16",
+	[AUDIO_SINC32] = "sinc32"
+};
+
+#define QUALITY_LEVELS (sizeof(quality_names) / sizeof(quality_names[0]))
+
+// parse_quality parses the argument of a --quality option.
+static enum audio_quality parse_quality(const char* cmd, const char* name)
+{
+	for (size_t i = 0; i < QUALITY_LEVELS; i++)
+		if (!strcmp(name, quality_names[i]))
+			return i;
+
+	LOG(ERROR, "unrecognized audio quality: %s", name);
+	printf("Run '%s help %s' for usage.\n", PACKAGE_NAME, cmd);
+	exit(EXIT_FAILURE);
+}
+
+// parse_run_ahead parses the argument of a --run-ahead option.
+static unsigned parse_run_ahead(const char* cmd, const char* arg)
+{
+	char* end;
+	unsigned long frames = strtoul(arg, &end, 10);
+	if (*end == '\0' && frames <= MAX_RUN_AHEAD)
+		return frames;
+
+	LOG(ERROR, "invalid run-ahead frames: %s (at most %d)", arg, MAX_RUN_AHEAD);
+	printf("Run '%s help %s' for usage.\n", PACKAGE_NAME, cmd);
+	exit(EXIT_FAILURE);
+}
+
+// parse_count parses the argument of an option that takes a count
+// (named by what) from min to max.
+static unsigned long long parse_count(const char* cmd, const char* what,
+	const char* arg, unsigned long long min, unsigned long long max)
+{
+	char* end;
+	errno = 0;
+	unsigned long long count = strtoull(arg, &end, 10);
+	if (*arg >= '0' && *arg <= '9' && *end == '\0' && !errno &&
+	    count >= min && count <= max)
+		return count;
+
+	LOG(ERROR, "invalid %s: %s", what, arg);
+	printf("Run '%s help %s' for usage.\n", PACKAGE_NAME, cmd);
+	exit(EXIT_FAILURE);
+}
+
 int run(int argc, char** argv)
 {
 	if (argc < 2) {
@@ -19,6 +108,76 @@ int run(int argc, char** argv)
 		exit(EXIT_FAILURE);
 	}
 
+	enum emu_sync sync = SYNC_CYCLE;
+	enum audio_quality quality = AUDIO_DEFAULT_QUALITY;
+	size_t rewind_mb = REWIND_BUDGET;
+	unsigned run_ahead = 0;
+	const char* record = NULL;
+	const char* play = NULL;
+	uint8_t headless = 0, uncapped = 0;
+	long seek = -1;
+	for (int i = 2; i < argc; i++) {
+		if (!strcmp(argv[i], "--sync") && i + 1 < argc) {
+			sync = parse_sync("run", argv[++i]);
+			continue;
+		}
+		if (!strcmp(argv[i], "--quality") && i + 1 < argc) {
+			quality = parse_quality("run", argv[++i]);
+			continue;
+		}
+		if (!strcmp(argv[i], "--run-ahead") && i + 1 < argc) {
+			run_ahead = parse_run_ahead("run", argv[++i]);
+			continue;
+		}
+		if (!strcmp(argv[i], "--record") && i + 1 < argc) {
+			record = argv[++i];
+			continue;
+		}
+		if (!strcmp(argv[i], "--play") && i + 1 < argc) {
+			play = argv[++i];
+			continue;
+		}
+		if (!strcmp(argv[i], "--seek") && i + 1 < argc) {
+			char* end;
+			seek = strtol(argv[++i], &end, 10);
+			if (*end == '\0' && seek >= 0)
+				continue;
+			LOG(ERROR, "invalid seek frame: %s", argv[i]);
+			printf("Run '%s help run' for usage.\n", PACKAGE_NAME);
+			exit(EXIT_FAILURE);
+		}
+		if (!strcmp(argv[i], "--headless")) {
+			headless = 1;
+			continue;
+		}
+		if (!strcmp(argv[i], "--uncapped")) {
+			uncapped = 1;
+			continue;
+		}
+		if (!strcmp(argv[i], "--rewind") && i + 1 < argc) {
+			rewind_mb = parse_count("run", "rewind budget", argv[++i], 0, MAX_REWIND_BUDGET);
+			continue;
+		}
+		LOG(ERROR, "unrecognized argument: %s", argv[i]);
+		printf("Run '%s help run' for usage.\n", PACKAGE_NAME);
+		exit(EXIT_FAILURE);
+	}
+
+	if ((record && play) || ((headless || seek >= 0) && !play)) {
+		LOG(ERROR, record && play ? "--record and --play cannot be combined" :
+		    "--headless and --seek need a movie to --play");
+		printf("Run '%s help run' for usage.\n", PACKAGE_NAME);
+		exit(EXIT_FAILURE);
+	}
+
+	// SDL is set up once for the whole process; emulators only open
+	// their own windows and audio devices.
+	if (!headless) {
+		if (gfx_init())
+			exit(EXIT_FAILURE);
+		atexit(gfx_quit);
+	}
+
 	mapper_t* mapper;
 	if (!(mapper = mapper_from_file(argv[1])))
 		exit(EXIT_FAILURE);
@@ -29,16 +188,380 @@ int run(int argc, char** argv)
 		exit(EXIT_FAILURE);
 	}
 
-	emulator_exec(emu);
+	emu->sync = sync;
+	emu->path = argv[1];
+	if ((rewind_mb && !headless &&
+	     !(emu->rewind = rewind_create(emu->machine, rewind_mb << 20, REWIND_INTERVAL))) ||
+	    apu_set_quality(emu->apu, quality) ||
+	    emulator_set_run_ahead(emu, run_ahead) ||
+	    (record && emulator_record_movie(emu, record)) ||
+	    (play && emulator_play_movie(emu, play)) ||
+	    (seek >= 0 && emulator_seek_movie(emu, seek))) {
+		emulator_destroy(emu);
+		mapper_destroy(mapper);
+		exit(EXIT_FAILURE);
+	}
+
+	if (headless) {
+		size_t start = emu->movie->frame;
+		emulator_exec_headless(emu);
+
+		// Playback only stops short of the end of a corrupt movie.
+		size_t frames = emu->movie->frame - start;
+		int err = (emu->movie->frame < emu->movie->frames);
+		LOG(INFO, "Emulated %zu frames in %.2f ms", frames, emu->time_diff);
+		LOG(INFO, "Frame rate: %.4f fps", (double)(frames * 1000) / emu->time_diff);
+		LOG(INFO, "CPU clock speed: %.4f MHz", ((double)emu->cpu->t_cycles / (1000 * emu->time_diff)));
+
+		err |= emulator_stop_movie(emu);
+		emulator_destroy(emu);
+		mapper_destroy(mapper);
+		return err ? EXIT_FAILURE : 0;
+	}
+
+	frontend_t* fe;
+	if (!(fe = frontend_create(emu))) {
+		emulator_destroy(emu);
+		mapper_destroy(mapper);
+		exit(EXIT_FAILURE);
+	}
+
+	fe->uncapped = uncapped;
+	frontend_exec(fe);
+	frontend_destroy(fe);
+	int err = emulator_stop_movie(emu);
 
 	LOG(INFO, "Play time %d min", (uint64_t)emu->time_diff / 60000);
 	LOG(INFO, "Frame rate: %.4f fps", (double)(emu->ppu->frames * 1000) / emu->time_diff);
-	LOG(INFO, "Audio sample rate: %.4f Hz", (double)(emu->apu->sampler.samples * 1000) / emu->time_diff);
+	LOG(INFO, "Audio sample rate: %.4f Hz", (double)(apu_output(emu->apu)->sampler.samples * 1000) / emu->time_diff);
+	LOG(INFO, "Audio latency: %.2f ms (%zu underruns)", apu_audio_latency(emu->apu),
+	    (size_t)atomic_load(&apu_output(emu->apu)->ring->underruns));
 	LOG(INFO, "CPU clock speed: %.4f MHz", ((double)emu->cpu->t_cycles / (1000 * emu->time_diff)));
+	if (emu->rewind) {
+		LOG(INFO, "Rewind history: %.1f s in %.2f MB", (double)rewind_frames(emu->rewind) *
+		    emu->period / 1e9, (double)emu->rewind->used / (1 << 20));
+	}
+	if (emu->ahead_count) {
+		LOG(INFO, "Run-ahead: %u frames, %.3f ms per frame", emu->run_ahead,
+		    emu->ahead_ms / emu->ahead_count);
+	}
 
 	emulator_destroy(emu);
 	mapper_destroy(mapper);
 
+	return err ? EXIT_FAILURE : 0;
+}
+
+// bench_result_t holds the measurements of one benchmark run.
+typedef struct
+{
+	double ms;
+	size_t frames;
+	size_t samples;
+	size_t steps;
+	size_t cycles;
+	size_t instrs;
+
+} bench_result_t;
+
+// bench_run emulates the ROM at path for the given number of frames
+// without a window or frame limiter.
+static bench_result_t bench_run(const char* path, size_t frames,
+	enum emu_sync sync, enum audio_quality quality, unsigned run_ahead)
+{
+	mapper_t* mapper;
+	if (!(mapper = mapper_from_file(path)))
+		exit(EXIT_FAILURE);
+
+	emulator_t* emu;
+	if (!(emu = emulator_create(mapper))) {
+		mapper_destroy(mapper);
+		exit(EXIT_FAILURE);
+	}
+
+	emu->sync = sync;
+	if (apu_set_quality(emu->apu, quality) ||
+	    emulator_set_run_ahead(emu, run_ahead))
+		exit(EXIT_FAILURE);
+
+	timerx_t timer = timerx_create(0);
+	timerx_mark_start(&timer);
+	for (size_t i = 0; i < frames; i++) {
+		emulator_run_frame(emu);
+		emulator_run_ahead(emu);
+		apu_discard_audio(emu->apu);
+	}
+	timerx_mark_end(&timer);
+
+	bench_result_t result = {
+		.ms      = timerx_get_diff(&timer),
+		.frames  = emu->ppu->frames,
+		.samples = apu_output(emu->apu)->sampler.samples,
+		.steps   = apu_output(emu->apu)->sampler.steps,
+		.cycles  = emu->cpu->t_cycles,
+		.instrs  = emu->cpu->t_instr
+	};
+	double rate = (emu->type == PAL) ? PAL_FRAME_RATE : NTSC_FRAME_RATE;
+	double fps = (double)(result.frames * 1000) / result.ms;
+
+	LOG(INFO, "Emulated %zu frames in %.2f ms", result.frames, result.ms);
+	LOG(INFO, "Frame rate: %.4f fps (%.2fx real time)", fps, fps / rate);
+	LOG(INFO, "Audio sample rate: %.4f Hz", (double)(result.samples * 1000) / result.ms);
+	LOG(INFO, "CPU clock speed: %.4f MHz", ((double)result.cycles / (1000 * result.ms)));
+	LOG(INFO, "Instruction rate: %.4f MIPS", ((double)result.instrs / (1000 * result.ms)));
+	if (emu->ahead_count) {
+		LOG(INFO, "Run-ahead: %u frames, %.3f ms per frame", emu->run_ahead,
+		    emu->ahead_ms / emu->ahead_count);
+	}
+
+	emulator_destroy(emu);
+	mapper_destroy(mapper);
+
+	return result;
+}
+
+// bench_verify emulates the ROM at path for the given number of frames
+// with the given sync mode and, alongside it, with SYNC_CYCLE, which
+// SYNC_CATCHUP must match: after every frame, the screens and RAM of
+// both are compared. It returns 0 if they never differ.
+static int bench_verify(const char* path, size_t frames, enum emu_sync sync)
+{
+	mapper_t* mapper;
+	if (!(mapper = mapper_from_file(path)))
+		exit(EXIT_FAILURE);
+
+	emulator_t* emu;
+	emulator_t* ref;
+	if (!(emu = emulator_create(mapper)) || !(ref = emulator_create(mapper)) ||
+	    apu_set_quality(emu->apu, AUDIO_OFF) || apu_set_quality(ref->apu, AUDIO_OFF))
+		exit(EXIT_FAILURE);
+	emu->sync = sync;
+	ref->sync = SYNC_CYCLE;
+
+	int err = 0;
+	for (size_t i = 0; i < frames && !err; i++) {
+		emulator_run_frame(emu);
+		emulator_run_frame(ref);
+
+		const uint8_t *emphasis, *ref_emphasis;
+		const uint8_t* screen = emulator_screen(emu, &emphasis);
+		const uint8_t* ref_screen = emulator_screen(ref, &ref_emphasis);
+		if (memcmp(screen, ref_screen, VISIBLE_SCANLINES * VISIBLE_DOTS) ||
+		    memcmp(emphasis, ref_emphasis, VISIBLE_SCANLINES)) {
+			LOG(ERROR, "Frame %zu is drawn differently with --sync cycle", i);
+			err = -1;
+		}
+		// A frame can end part way through an instruction with
+		// SYNC_CYCLE, whose writes then land in the next frame, so
+		// RAM is only compared when both CPUs are at the same cycle.
+		else if (emu->cpu->t_cycles == ref->cpu->t_cycles &&
+			 memcmp(emulator_ram(emu), emulator_ram(ref), RAM_SIZE)) {
+			LOG(ERROR, "RAM differs from --sync cycle after frame %zu", i);
+			err = -1;
+		}
+	}
+	if (!err)
+		LOG(INFO, "Matched --sync cycle for %zu frames", frames);
+
+	emulator_destroy(emu);
+	emulator_destroy(ref);
+	mapper_destroy(mapper);
+	return err;
+}
+
+// bench_batch emulates count instances of the ROM at path for the
+// given number of frames, stepped together by a batch_t on the given
+// number of threads (0 for one per CPU).
+static void bench_batch(const char* path, size_t frames, enum emu_sync sync,
+	enum audio_quality quality, size_t count, unsigned threads)
+{
+	mapper_t* mapper;
+	if (!(mapper = mapper_from_file(path)))
+		exit(EXIT_FAILURE);
+
+	// The emulators share one copy of the ROM.
+	emulator_t** emus = calloc(count, sizeof(emulator_t*));
+	uint8_t* screens  = malloc(count * BATCH_SCREEN_SIZE);
+	if (emus == NULL || screens == NULL) {
+		LOG(ERROR, "Failed to allocate %zu emulators", count);
+		exit(EXIT_FAILURE);
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		if (!(emus[i] = emulator_create(mapper)) ||
+		    apu_set_quality(emus[i]->apu, quality))
+			exit(EXIT_FAILURE);
+		emus[i]->sync = sync;
+	}
+
+	batch_t* batch;
+	if (!(batch = batch_create(emus, count, threads)))
+		exit(EXIT_FAILURE);
+
+	timerx_t timer = timerx_create(0);
+	timerx_mark_start(&timer);
+	for (size_t i = 0; i < frames; i++)
+		batch_step(batch, NULL, 1, screens, NULL);
+	timerx_mark_end(&timer);
+
+	double ms = timerx_get_diff(&timer);
+	double rate = (emus[0]->type == PAL) ? PAL_FRAME_RATE : NTSC_FRAME_RATE;
+	double fps = (double)(frames * count * 1000) / ms;
+
+	LOG(INFO, "Emulated %zu frames of %zu emulators on %u threads in %.2f ms",
+	    frames, count, batch->worker_count, ms);
+	LOG(INFO, "Frame rate: %.4f fps (%.2fx real time), %.4f fps per emulator",
+	    fps, fps / rate, fps / count);
+
+	batch_destroy(batch);
+	for (size_t i = 0; i < count; i++)
+		emulator_destroy(emus[i]);
+	mapper_destroy(mapper);
+	free(screens);
+	free(emus);
+}
+
+// bench_resampler returns the time, in ns per output sample, taken to
+// synthesise and read a pseudo-random pattern of steps_per_clock
+// amplitude steps per clock with a kernel of the given width.
+static double bench_resampler(int width, double clocks_per_sample, double steps_per_clock)
+{
+	float* kernel;
+	if (!(kernel = blip_kernel_create(width)))
+		exit(EXIT_FAILURE);
+
+	// Generate the pattern up front, so that only the resampler is timed.
+	static uint16_t clocks[RESAMPLER_STEPS];
+	static float deltas[RESAMPLER_STEPS];
+	uint32_t seed = 1;
+	for (int i = 0; i < RESAMPLER_STEPS; i++) {
+		seed = seed * 1664525 + 1013904223;
+		clocks[i] = (seed >> 8) % BLIP_FLUSH_CLOCKS;
+		deltas[i] = (float)(seed >> 24) / 256 - 0.5f;
+	}
+
+	blip_t blip = blip_create(kernel, width, clocks_per_sample);
+	float out[BLIP_BUFF_SIZE];
+	double due = 0;
+	size_t step = 0, samples = 0;
+
+	timerx_t timer = timerx_create(0);
+	timerx_mark_start(&timer);
+	for (int frame = 0; frame < RESAMPLER_FRAMES; frame++) {
+		due += steps_per_clock * BLIP_FLUSH_CLOCKS;
+		for (; due >= 1; due--, step = (step + 1) % RESAMPLER_STEPS)
+			blip_add_delta(&blip, clocks[step], deltas[step]);
+
+		blip_end_frame(&blip, BLIP_FLUSH_CLOCKS);
+		samples += blip_read_samples(&blip, out, BLIP_BUFF_SIZE);
+	}
+	timerx_mark_end(&timer);
+
+	blip_kernel_destroy(kernel);
+	return timerx_get_diff(&timer) * 1000000 / samples;
+}
+
+int bench(int argc, char** argv)
+{
+	if (argc < 2) {
+		LOG(ERROR, "\"bench\" command expected ROM path as argument");
+		printf("Run '%s help bench' for usage.\n", PACKAGE_NAME);
+		exit(EXIT_FAILURE);
+	}
+
+	size_t frames = BENCH_FRAMES;
+	enum emu_sync sync = SYNC_CYCLE;
+	enum audio_quality quality = AUDIO_DEFAULT_QUALITY;
+	uint8_t all_qualities = 0;
+	unsigned run_ahead = 0;
+	size_t batch = 0;
+	unsigned threads = 0;
+	uint8_t verify = 0;
+	for (int i = 2; i < argc; i++) {
+		if (!strcmp(argv[i], "--frames") && i + 1 < argc) {
+			frames = parse_count("bench", "frame count", argv[++i], 1, SIZE_MAX);
+			continue;
+		}
+		if (!strcmp(argv[i], "--batch") && i + 1 < argc) {
+			batch = parse_count("bench", "batch size", argv[++i], 1, UINT32_MAX);
+			continue;
+		}
+		if (!strcmp(argv[i], "--threads") && i + 1 < argc) {
+			threads = parse_count("bench", "thread count", argv[++i], 0, UINT_MAX);
+			continue;
+		}
+		if (!strcmp(argv[i], "--sync") && i + 1 < argc) {
+			sync = parse_sync("bench", argv[++i]);
+			continue;
+		}
+		if (!strcmp(argv[i], "--quality") && i + 1 < argc) {
+			if (!strcmp(argv[++i], "all"))
+				all_qualities = 1;
+			else
+				quality = parse_quality("bench", argv[i]);
+			continue;
+		}
+		if (!strcmp(argv[i], "--run-ahead") && i + 1 < argc) {
+			run_ahead = parse_run_ahead("bench", argv[++i]);
+			continue;
+		}
+		if (!strcmp(argv[i], "--verify")) {
+			verify = 1;
+			continue;
+		}
+		LOG(ERROR, "unrecognized argument: %s", argv[i]);
+		printf("Run '%s help bench' for usage.\n", PACKAGE_NAME);
+		exit(EXIT_FAILURE);
+	}
+
+	if (verify) {
+		if (batch || all_qualities || run_ahead) {
+			LOG(ERROR, "--verify cannot be combined with --batch, --quality all or --run-ahead");
+			printf("Run '%s help bench' for usage.\n", PACKAGE_NAME);
+			exit(EXIT_FAILURE);
+		}
+		return bench_verify(argv[1], frames, sync) ? EXIT_FAILURE : 0;
+	}
+
+	if (batch) {
+		if (all_qualities || run_ahead) {
+			LOG(ERROR, "--batch cannot be combined with --quality all or --run-ahead");
+			printf("Run '%s help bench' for usage.\n", PACKAGE_NAME);
+			exit(EXIT_FAILURE);
+		}
+		bench_batch(argv[1], frames, sync, quality, batch, threads);
+		return 0;
+	}
+
+	if (!all_qualities) {
+		bench_run(argv[1], frames, sync, quality, run_ahead);
+		return 0;
+	}
+
+	// Emulating the ROM once per level would bury the cost of the
+	// resampler in the noise of everything else. Instead, measure how
+	// often the ROM's output changes, and time each level on its own
+	// over a step pattern of the same density.
+	bench_result_t result = bench_run(argv[1], frames, sync, AUDIO_DEFAULT_QUALITY, run_ahead);
+	if (!result.steps) {
+		LOG(ERROR, "ROM produced no audio to resample");
+		exit(EXIT_FAILURE);
+	}
+
+	double clocks_per_sample = (double)result.cycles / result.samples;
+	double steps_per_clock = (double)result.steps / result.cycles;
+	LOG(INFO, "Amplitude steps: %.2f per output sample", steps_per_clock * clocks_per_sample);
+
+	for (size_t q = AUDIO_OFF + 1; q < QUALITY_LEVELS; q++) {
+		double ns = 0;
+		for (int round = 0; round < RESAMPLER_ROUNDS; round++) {
+			double t = bench_resampler(apu_quality_width(q), clocks_per_sample, steps_per_clock);
+			if (round == 0 || t < ns)
+				ns = t;
+		}
+		LOG(INFO, "%-6s: %.2f ns per output sample", quality_names[q], ns);
+	}
+
 	return 0;
 }
 
@@ -56,8 +579,31 @@ int help(int argc, char** argv)
 	}
 
 	if (!strcmp(argv[1], "run")) {
-		printf("usage: %s run [NES ROM File]\n\n", PACKAGE_NAME);
+		printf("usage: %s run [NES ROM File] [--sync cycle|instr|catchup] [--quality LEVEL]\n", PACKAGE_NAME);
+		printf("\t[--rewind MB] [--run-ahead N] [--record FILE | --play FILE [--seek N]\n");
+		printf("\t[--headless]] [--uncapped]\n\n");
 		printf("Runs the specified NES ROM file. Only iNES file format is currently accepted.\n\n");
+		printf("Options:\n\n");
+		printf("\t--sync cycle\tLock-step the CPU, PPU and APU every CPU cycle (default)\n");
+		printf("\t--sync instr\tExecute whole CPU instructions, then catch the PPU and APU up\n");
+		printf("\t--sync catchup\tLet the CPU run ahead; catch the PPU and APU up only when their\n");
+		printf("\t\t\tregisters are accessed or an interrupt or frame end is due\n");
+		printf("\t--quality LEVEL\tAudio resampling quality: off, linear, sinc8, sinc16\n");
+		printf("\t\t\t(default) or sinc32\n");
+		printf("\t--rewind MB\tMemory kept for rewinding (default %d, at most %d); 0\n",
+		    REWIND_BUDGET, MAX_REWIND_BUDGET);
+		printf("\t\t\tdisables it\n");
+		printf("\t--run-ahead N\tEmulate N frames (at most %d) ahead of each frame shown\n", MAX_RUN_AHEAD);
+		printf("\t\t\tand show the last, hiding N frames of the game's input lag\n");
+		printf("\t--record FILE\tRecord the input of every frame to a movie\n");
+		printf("\t--play FILE\tPlay a movie back, then hand control to the keyboard; the\n");
+		printf("\t\t\tfinal state is checked against the recording\n");
+		printf("\t--seek N\tStart playback at frame N. Keyframes written next to the\n");
+		printf("\t\t\tmovie (FILE.idx) when it is recorded or first played in\n");
+		printf("\t\t\tfull keep this to at most %d frames of emulation\n", MOVIE_KEYFRAME_INTERVAL);
+		printf("\t--headless\tPlay the movie back without a window, audio or frame\n");
+		printf("\t\t\tlimiter, and exit at its end\n");
+		printf("\t--uncapped\tRun as fast as possible, without audio\n\n");
 		printf("Keyboard map:\n\n");
 		printf("\tARROW KEYS:\tUP/DOWN/RIGHT/LEFT\n");
 		printf("\tRETURN:\t\tSTART\n");
@@ -66,8 +612,26 @@ int help(int argc, char** argv)
 		printf("\tJ:\t\tBUTTON A\n");
 		printf("\tK:\t\tBUTTON B\n");
 		printf("\tL:\t\tTURBO B\n");
-		printf("\tQ:\t\tCapture save point\n");
-		printf("\tTAB:\t\tRecover save point\n\n");
+		printf("\t0-9:\t\tSelect save state slot (default 0)\n");
+		printf("\tQ:\t\tSave state to the selected slot\n");
+		printf("\tTAB:\t\tLoad state from the selected slot\n");
+		printf("\tBACKSPACE:\tRewind (hold)\n\n");
+		exit(EXIT_SUCCESS);
+	}
+
+	if (!strcmp(argv[1], "bench")) {
+		printf("usage: %s bench [NES ROM File] [--frames N] [--sync cycle|instr|catchup]\n", PACKAGE_NAME);
+		printf("\t[--quality LEVEL|all] [--run-ahead N] [--batch N [--threads T]] [--verify]\n\n");
+		printf("Runs the specified NES ROM file for N frames (default %d) without a\n", BENCH_FRAMES);
+		printf("window, audio device or frame limiter, and reports emulation speed.\n");
+		printf("With --quality all, the ROM is run once to measure how often its audio\n");
+		printf("changes, then each audio quality level's resampler is timed on its own\n");
+		printf("over a pattern of steps as dense, and its cost per output sample reported.\n");
+		printf("With --batch N, N instances of the ROM are stepped together on T threads\n");
+		printf("(default: one per CPU), and their combined frame rate reported.\n");
+		printf("With --verify, the ROM is also run with --sync cycle, and the screen and\n");
+		printf("RAM after every frame are checked to be the same.\n");
+		printf("See '%s help run' for the --sync, --quality and --run-ahead options.\n", PACKAGE_NAME);
 		exit(EXIT_SUCCESS);
 	}
 
@@ -99,6 +663,9 @@ int main(int argc, char** argv)
 	if (!strcmp(argv[1], "run"))
 		return run(argc - 1, &argv[1]);
 
+	if (!strcmp(argv[1], "bench"))
+		return bench(argc - 1, &argv[1]);
+
 	if (!strcmp(argv[1], "version"))
 		return version();
 
@@ -11,19 +11,64 @@ static void set_mapping
 	mapper->nametable_map[3] = br;
 }
 
-mapper_t* mapper_from_file(const char* path)
+// checksum returns the FNV-1a hash of len bytes at data, continuing
+// from hash.
+static uint32_t checksum(uint32_t hash, const uint8_t* data, size_t len)
 {
-	SDL_RWops* file;
-	if (!(file = SDL_RWFromFile(path, "rb"))) {
-		LOG(ERROR, "file '%s' not found", path);
-		return NULL;
+	for (size_t i = 0; i < len; i++) {
+		hash ^= data[i];
+		hash *= 16777619;
+	}
+	return hash;
+}
+
+// chr_size returns the size of CHR ROM (or RAM) in bytes.
+static size_t chr_size(const mapper_t* mapper)
+{ return mapper->chr_banks ? 0x2000 * mapper->chr_banks : mapper->chr_ram_size; }
+
+// decode_row decodes the pattern row at CHR address addr (either of its
+// two planes) into the tile caches.
+static void decode_row(mapper_t* mapper, uint16_t addr)
+{
+	uint16_t base = addr & ~0x8;
+	uint8_t lo = mapper->chr_rom[base], hi = mapper->chr_rom[base + 8];
+	size_t offset = (base >> 4) * 64 + (base & 7) * 8;
+
+	for (int i = 0; i < 8; i++) {
+		uint8_t pixel = ((lo >> (7 - i)) & 1) | (((hi >> (7 - i)) & 1) << 1);
+		mapper->chr_tiles[offset + i] = pixel;
+		mapper->chr_tiles_flipped[offset + 7 - i] = pixel;
 	}
+}
 
-	uint8_t header[INES_HEADER_SIZE];
-	SDL_RWread(file, header, INES_HEADER_SIZE, 1);
-	if (strncmp((const char*)header, "NES\x1A", 4) != 0) {
+void mapper_decode_chr(mapper_t* mapper)
+{
+	for (size_t addr = 0; addr < chr_size(mapper); addr += 16) {
+		for (int row = 0; row < 8; row++)
+			decode_row(mapper, addr + row);
+	}
+}
+
+void mapper_update_chr(mapper_t* mapper, const uint8_t* chr)
+{
+	for (size_t addr = 0; addr < mapper->chr_ram_size; addr += 16) {
+		if (!memcmp(mapper->chr_rom + addr, chr + addr, 16))
+			continue;
+		memcpy(mapper->chr_rom + addr, chr + addr, 16);
+		for (int row = 0; row < 8; row++)
+			decode_row(mapper, addr + row);
+	}
+}
+
+// load creates a mapper_t from the size bytes of an iNES image at data.
+// path is the name of the file it was read from, or NULL.
+static mapper_t* load(const uint8_t* data, size_t size, const char* path)
+{
+	const uint8_t* header = data;
+	if (size < INES_HEADER_SIZE ||
+	    strncmp((const char*)header, "NES\x1A", 4) != 0) {
 		LOG(ERROR, "unknown file format");
-		exit(EXIT_FAILURE);
+		return NULL;
 	}
 
 	if (header[6] & BIT_2) {
@@ -31,7 +76,23 @@ mapper_t* mapper_from_file(const char* path)
 		return NULL;
 	}
 
+	if (header[4] == 0) {
+		LOG(ERROR, "ROM has no PRG ROM");
+		return NULL;
+	}
+
+	// Bank counts are single bytes, so this cannot overflow.
+	if (size < INES_HEADER_SIZE + 0x4000 * header[4] + 0x2000 * header[5]) {
+		LOG(ERROR, "ROM is truncated");
+		return NULL;
+	}
+	data += INES_HEADER_SIZE;
+
 	mapper_t* mapper = malloc(sizeof(mapper_t));
+	if (mapper == NULL) {
+		LOG(ERROR, "Failed to allocate mapper");
+		return NULL;
+	}
 	memset(mapper, 0, sizeof(mapper_t));
 
 	mapper->id = ((header[6] & 0xF0) >> 4) | (header[7] & 0xF0);
@@ -53,7 +114,7 @@ mapper_t* mapper_from_file(const char* path)
 	mapper->type = (header[9] & 1) ? PAL : NTSC;
 
 	// probably PAL ROM
-	if (strstr(path, "(E)") != NULL && mapper->type == NTSC) {
+	if (path && strstr(path, "(E)") != NULL && mapper->type == NTSC) {
 		mapper->type = PAL;
         }
 
@@ -70,27 +131,45 @@ mapper_t* mapper_from_file(const char* path)
 		mapper->ram_size = 0x2000;
 	}
 
-	if (mapper->ram_size) {
-		mapper->prg_ram = malloc(mapper->ram_size);
-		memset(mapper->prg_ram, 0, mapper->ram_size);
-	}
+	// Only one bank can be mapped at 0x6000-0x7FFF.
+	if (mapper->ram_size > PRG_RAM_SIZE)
+		mapper->ram_size = PRG_RAM_SIZE;
 
 	LOG(INFO, "PRG banks (16KB): %u", mapper->prg_banks);
 	LOG(INFO, "CHR banks (8KB): %u", mapper->chr_banks);
 
-	mapper->prg_rom = malloc(0x4000 * mapper->prg_banks);
-	SDL_RWread(file, mapper->prg_rom, 0x4000 * mapper->prg_banks, 1);
+	if (!(mapper->prg_rom = malloc(0x4000 * mapper->prg_banks))) {
+		LOG(ERROR, "Failed to allocate PRG ROM");
+		mapper_destroy(mapper);
+		return NULL;
+	}
+	memcpy(mapper->prg_rom, data, 0x4000 * mapper->prg_banks);
+	data += 0x4000 * mapper->prg_banks;
 
 	if (mapper->chr_banks) {
-		mapper->chr_rom = malloc(0x2000 * mapper->chr_banks);
-		SDL_RWread(file, mapper->chr_rom, 0x2000 * mapper->chr_banks, 1);
+		if (!(mapper->chr_rom = malloc(0x2000 * mapper->chr_banks))) {
+			LOG(ERROR, "Failed to allocate CHR ROM");
+			mapper_destroy(mapper);
+			return NULL;
+		}
+		memcpy(mapper->chr_rom, data, 0x2000 * mapper->chr_banks);
 	}
 	else {
 		LOG(INFO, "Using CHR ROM");
-		mapper->chr_ram_size = (mapper->chr_ram_size) ?
-			mapper->chr_ram_size : 0x2000;
-		mapper->chr_rom = malloc(mapper->chr_ram_size);
-		memset(mapper->chr_rom, 0, mapper->chr_ram_size);
+		mapper->chr_ram_size = CHR_RAM_SIZE;
+	}
+
+	// Each 16-byte tile decodes to 64 pixels. CHR RAM is decoded by
+	// each machine it is attached to (see mapper_attach).
+	if (mapper->chr_banks) {
+		mapper->chr_tiles = malloc(chr_size(mapper) * 4);
+		mapper->chr_tiles_flipped = malloc(chr_size(mapper) * 4);
+		if (!mapper->chr_tiles || !mapper->chr_tiles_flipped) {
+			LOG(ERROR, "Failed to allocate CHR tiles");
+			mapper_destroy(mapper);
+			return NULL;
+		}
+		mapper_decode_chr(mapper);
 	}
 
 	switch (mapper->type) {
@@ -106,7 +185,10 @@ mapper_t* mapper_from_file(const char* path)
 
 	LOG(INFO, "Using mapper #%d", mapper->id);
 	mapper->clamp = (mapper->prg_banks * 0x4000) - 1;
-	SDL_RWclose(file);
+
+	mapper->checksum = checksum(2166136261u, mapper->prg_rom, 0x4000 * mapper->prg_banks);
+	if (mapper->chr_banks)
+		mapper->checksum = checksum(mapper->checksum, mapper->chr_rom, 0x2000 * mapper->chr_banks);
 
 	// Set mirroring.
 	switch (mirroring) {
@@ -132,14 +214,78 @@ mapper_t* mapper_from_file(const char* path)
 	return mapper;
 }
 
+mapper_t* mapper_from_memory(const uint8_t* data, size_t size)
+{ return load(data, size, NULL); }
+
+mapper_t* mapper_from_file(const char* path)
+{
+	FILE* file;
+	if (!(file = fopen(path, "rb"))) {
+		LOG(ERROR, "file '%s' not found", path);
+		return NULL;
+	}
+
+	long size;
+	uint8_t* data = NULL;
+	if (fseek(file, 0, SEEK_END) || (size = ftell(file)) < 0 ||
+	    fseek(file, 0, SEEK_SET) || !(data = malloc(size + 1)) ||
+	    fread(data, 1, size, file) != (size_t)size) {
+		LOG(ERROR, "Failed to read '%s'", path);
+		free(data);
+		fclose(file);
+		return NULL;
+	}
+	fclose(file);
+
+	mapper_t* mapper = load(data, size, path);
+	free(data);
+	return mapper;
+}
+
 void mapper_destroy(mapper_t* mapper)
 {
 	free(mapper->prg_rom);
-	free(mapper->chr_rom);
-	free(mapper->prg_ram);
+	if (mapper->chr_banks)
+		free(mapper->chr_rom);
+	free(mapper->chr_tiles);
+	free(mapper->chr_tiles_flipped);
 	free(mapper);
 }
 
+int mapper_attach(mapper_t* cart, const mapper_t* rom, uint8_t* prg_ram,
+	uint8_t* chr_ram)
+{
+	*cart = *rom;
+	cart->prg_ram = NULL;
+	if (cart->ram_size) {
+		cart->prg_ram = prg_ram;
+		memset(prg_ram, 0, cart->ram_size);
+	}
+
+	if (cart->chr_ram_size) {
+		cart->chr_rom = chr_ram;
+		memset(chr_ram, 0, cart->chr_ram_size);
+		cart->chr_tiles = malloc(cart->chr_ram_size * 4);
+		cart->chr_tiles_flipped = malloc(cart->chr_ram_size * 4);
+		if (cart->chr_tiles == NULL || cart->chr_tiles_flipped == NULL) {
+			LOG(ERROR, "Failed to allocate CHR RAM tiles");
+			mapper_detach(cart);
+			return -1;
+		}
+		mapper_decode_chr(cart);
+	}
+	return 0;
+}
+
+void mapper_detach(mapper_t* cart)
+{
+	if (!cart->chr_ram_size)
+		return;
+	free(cart->chr_tiles);
+	free(cart->chr_tiles_flipped);
+	cart->chr_tiles = cart->chr_tiles_flipped = NULL;
+}
+
 uint8_t mapper_read_rom(mapper_t* mapper, uint8_t bus, uint16_t addr)
 {
 	if (addr < 0x6000) {
@@ -193,4 +339,49 @@ void mapper_write_chr(mapper_t* mapper, uint16_t addr, uint8_t val)
 		return;
 	}
 	mapper->chr_rom[addr] = val;
+	decode_row(mapper, addr);
+}
+
+#define MAPPER_STATE_VERSION 1
+
+void mapper_save(mapper_t* mapper, state_t* state)
+{
+	state_begin(state, "MAPR", MAPPER_STATE_VERSION);
+	state_write_u32(state, mapper->checksum);
+	state_write_u8(state, mapper->mirroring);
+	for (int i = 0; i < 4; i++)
+		state_write_u16(state, mapper->nametable_map[i]);
+
+	state_write_u32(state, mapper->ram_size);
+	state_write(state, mapper->prg_ram, mapper->ram_size);
+	state_write_u32(state, mapper->chr_ram_size);
+	state_write(state, mapper->chr_rom, mapper->chr_ram_size);
+	state_end(state);
+}
+
+int mapper_load(mapper_t* mapper, state_t* state)
+{
+	if (state_open(state, "MAPR", MAPPER_STATE_VERSION) < 0)
+		return -1;
+
+	if (state_read_u32(state) != mapper->checksum) {
+		LOG(ERROR, "Save state was made with another ROM");
+		return -1;
+	}
+
+	mapper->mirroring = state_read_u8(state);
+	for (int i = 0; i < 4; i++)
+		mapper->nametable_map[i] = state_read_u16(state) & 0xC00;
+
+	if (state_read_u32(state) != mapper->ram_size)
+		return -1;
+	state_read(state, mapper->prg_ram, mapper->ram_size);
+
+	if (state_read_u32(state) != mapper->chr_ram_size)
+		return -1;
+	state_read(state, mapper->chr_rom, mapper->chr_ram_size);
+	if (mapper->chr_ram_size)
+		mapper_decode_chr(mapper);
+
+	return state->error ? -1 : 0;
 }
@@ -2,6 +2,7 @@
 #define NES_TOOLS_MAPPER_H
 
 #include "system.h"
+#include "state.h"
 
 // The NES console had two main variants based on different TV display
 // standards: NTSC (used primarily in Japan/USA) and PAL (used in
@@ -23,7 +24,16 @@ enum mirroring
 	FOUR_SCREEN
 };
 
-// mapper_t stores data for an iNES mapper/cartridge.
+// Largest PRG RAM and CHR RAM a cartridge can have.
+#define PRG_RAM_SIZE 0x2000
+#define CHR_RAM_SIZE 0x2000
+
+// mapper_t stores data for an iNES mapper/cartridge. A mapper_t loaded
+// from a ROM only holds the ROM and is never written to, so any number
+// of machines may share it. Each machine plugs in its own copy (see
+// mapper_attach), which shares the ROM but has the machine's RAM, its
+// own mirroring and, if the cartridge has CHR RAM, its own decoded
+// tiles; chr_rom then points to CHR RAM.
 typedef struct
 {
 	uint8_t* chr_rom;
@@ -41,15 +51,36 @@ typedef struct
 
 	uint16_t nametable_map[4];
 
+	// CHR tiles decoded to one byte (colour index 0-3) per pixel, 64
+	// bytes per tile, plus a horizontally mirrored copy.
+	uint8_t* chr_tiles;
+	uint8_t* chr_tiles_flipped;
+
 	uint32_t clamp;
 	uint8_t  id;
 
+	// Checksum of the PRG and CHR ROM, which tells save states of
+	// different games apart.
+	uint32_t checksum;
+
 } mapper_t;
 
 // mapper_from_file creates a mapper_t instance from a '.nes' file.
 mapper_t* mapper_from_file(const char* path);
+
+// mapper_from_memory creates a mapper_t instance from the size bytes of
+// a '.nes' image at data, which it copies.
+mapper_t* mapper_from_memory(const uint8_t* data, size_t size);
 void mapper_destroy(mapper_t* mapper);
 
+// mapper_attach makes cart a copy of rom that shares its ROM and uses
+// the given PRG RAM (PRG_RAM_SIZE bytes) and CHR RAM (CHR_RAM_SIZE
+// bytes), which it clears. It returns 0 on success. mapper_detach frees
+// what the copy does not share; rom must outlive it.
+int mapper_attach(mapper_t* cart, const mapper_t* rom, uint8_t* prg_ram,
+	uint8_t* chr_ram);
+void mapper_detach(mapper_t* cart);
+
 // mapper_read_rom fetches data from CPU-addressable locations in the
 // mapper circuit's memory. If an address is invalid, it returns bus.
 uint8_t mapper_read_rom(mapper_t* mapper, uint8_t bus, uint16_t addr);
@@ -72,4 +103,28 @@ uint8_t mapper_read_chr(mapper_t* mapper, uint16_t addr);
 // mapper_read_chr writes val to the mapper's CHR ROM at the given addr.
 void mapper_write_chr(mapper_t* mapper, uint16_t addr, uint8_t val);
 
+// mapper_save writes the cartridge's mutable state (PRG RAM, CHR RAM
+// and mirroring) to a "MAPR" chunk, and mapper_load reads it back. ROM
+// is not part of the state; mapper_load fails if the state was saved
+// with another ROM. mapper_load returns 0 on success.
+void mapper_save(mapper_t* mapper, state_t* state);
+int mapper_load(mapper_t* mapper, state_t* state);
+
+// mapper_decode_chr rebuilds the decoded tile cache from CHR memory.
+void mapper_decode_chr(mapper_t* mapper);
+
+// mapper_update_chr replaces CHR RAM with chr, decoding only the tiles
+// that change.
+void mapper_update_chr(mapper_t* mapper, const uint8_t* chr);
+
+// mapper_chr_row returns the 8 decoded pixels of the pattern row at
+// CHR address addr (tile * 16 + row), mirrored horizontally if flip
+// is set.
+static inline const uint8_t* mapper_chr_row
+(const mapper_t* mapper, uint16_t addr, uint8_t flip)
+{
+	size_t offset = (addr >> 4) * 64 + (addr & 7) * 8;
+	return (flip ? mapper->chr_tiles_flipped : mapper->chr_tiles) + offset;
+}
+
 #endif // NES_TOOLS_MAPPER_H
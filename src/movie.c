@@ -0,0 +1,519 @@
+#include "movie.h"
+#include "delta.h"
+#include "emulator.h"
+
+#define HEADER_SIZE 24
+#define INDEX_HEADER_SIZE 36
+
+// Longest encoding of a run: a 5-byte varint, the flags and both
+// joypads.
+#define MAX_RUN_SIZE 10
+
+static void put(uint8_t* out, uint64_t val, int bytes)
+{
+	for (int i = 0; i < bytes; i++)
+		out[i] = val >> (8 * i);
+}
+
+static uint64_t get(const uint8_t* in, int bytes)
+{
+	uint64_t val = 0;
+	for (int i = 0; i < bytes; i++)
+		val |= (uint64_t)in[i] << (8 * i);
+	return val;
+}
+
+// reserve makes room for len more bytes in a buffer holding used bytes.
+// It returns 0 on success.
+static int reserve(uint8_t** data, size_t* cap, size_t used, size_t len)
+{
+	if (used + len <= *cap)
+		return 0;
+
+	size_t size = *cap ? *cap : 0x1000;
+	while (size < used + len)
+		size *= 2;
+
+	uint8_t* grown = realloc(*data, size);
+	if (grown == NULL) {
+		LOG(ERROR, "Failed to allocate movie buffer");
+		return -1;
+	}
+	*data = grown;
+	*cap  = size;
+	return 0;
+}
+
+// write_file writes a header and a body to path, replacing any
+// previous file only once the new one is complete.
+static int write_file(const char* path, const uint8_t* header, size_t header_len,
+	const uint8_t* body, size_t body_len)
+{
+	char tmp[FILENAME_MAX];
+	if (snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int)sizeof(tmp)) {
+		LOG(ERROR, "Movie path too long: %s", path);
+		return -1;
+	}
+
+	FILE* file = fopen(tmp, "wb");
+	if (file == NULL) {
+		LOG(ERROR, "Failed to open %s", tmp);
+		return -1;
+	}
+
+	size_t written = fwrite(header, 1, header_len, file);
+	if (body_len)
+		written += fwrite(body, 1, body_len, file);
+	if (fclose(file) || written != header_len + body_len || rename(tmp, path)) {
+		LOG(ERROR, "Failed to write %s", path);
+		remove(tmp);
+		return -1;
+	}
+	return 0;
+}
+
+// read_file reads the file at path into a header of header_len bytes
+// and a body, allocated into *body. It returns the body's length, or
+// -1 if the file cannot be read or is shorter than the header. If
+// quiet is set, a missing file is not reported.
+static long read_file(const char* path, uint8_t* header, size_t header_len,
+	uint8_t** body, uint8_t quiet)
+{
+	FILE* file = fopen(path, "rb");
+	if (file == NULL) {
+		if (!quiet)
+			LOG(ERROR, "Failed to open %s", path);
+		return -1;
+	}
+
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file) - (long)header_len;
+	fseek(file, 0, SEEK_SET);
+
+	*body = NULL;
+	if (size < 0 || !(*body = malloc(size ? size : 1)) ||
+	    fread(header, 1, header_len, file) != header_len ||
+	    fread(*body, 1, size, file) != (size_t)size) {
+		LOG(ERROR, "Failed to read %s", path);
+		free(*body);
+		*body = NULL;
+		fclose(file);
+		return -1;
+	}
+	fclose(file);
+	return size;
+}
+
+// index_path writes the path of the movie's index to path.
+static int index_path(movie_t* movie, char* path, size_t size)
+{
+	if (snprintf(path, size, "%s.idx", movie->path) >= (int)size) {
+		LOG(ERROR, "Movie path too long: %s", movie->path);
+		return -1;
+	}
+	return 0;
+}
+
+// flush appends the run being recorded to the encoded runs. It returns
+// -1, and sets movie->error, if there is no memory for it.
+static int flush(movie_t* movie)
+{
+	if (movie->error)
+		return -1;
+	if (!movie->run)
+		return 0;
+
+	if (reserve(&movie->data, &movie->cap, movie->len, MAX_RUN_SIZE)) {
+		movie->error = 1;
+		return -1;
+	}
+	uint8_t* out = movie->data + movie->len;
+	uint32_t run = movie->run;
+	while (run >= 0x80) {
+		*out++ = (run & 0x7f) | 0x80;
+		run >>= 7;
+	}
+	*out++ = run;
+
+	*out++ = movie->input.reset ? MOVIE_RESET : 0;
+	put(out, movie->input.joy1, 2);
+	put(out + 2, movie->input.joy2, 2);
+	out += 4;
+
+	movie->len = out - movie->data;
+	movie->run = 0;
+	return 0;
+}
+
+// next decodes the run at movie->pos. It returns 0, or -1 if the runs
+// end there or are corrupt.
+static int next(movie_t* movie)
+{
+	const uint8_t* in  = movie->data + movie->pos;
+	const uint8_t* end = movie->data + movie->len;
+
+	uint32_t run = 0;
+	for (int shift = 0; ; shift += 7) {
+		if (in == end || shift > 28)
+			return -1;
+		run |= (uint32_t)(*in & 0x7f) << shift;
+		if (!(*in++ & 0x80))
+			break;
+	}
+	if (!run || end - in < 5)
+		return -1;
+
+	movie->input.reset = (in[0] & MOVIE_RESET) != 0;
+	movie->input.joy1  = get(in + 1, 2);
+	movie->input.joy2  = get(in + 3, 2);
+	movie->run = run;
+	movie->pos = in + 5 - movie->data;
+	return 0;
+}
+
+// locate moves playback to the given frame, which must not be past
+// the end of the movie. It returns 0, or -1 if the runs are corrupt.
+static int locate(movie_t* movie, uint32_t frame)
+{
+	movie->pos   = 0;
+	movie->run   = 0;
+	movie->frame = 0;
+
+	while (movie->frame < frame) {
+		if (!movie->run && next(movie))
+			return -1;
+
+		uint32_t skip = frame - movie->frame;
+		if (skip > movie->run)
+			skip = movie->run;
+
+		movie->input.reset = 0;
+		movie->run   -= skip;
+		movie->frame += skip;
+	}
+	return 0;
+}
+
+// load_index reads the movie's index, if it has one matching the
+// movie and the machine's state.
+static void load_index(movie_t* movie)
+{
+	char path[FILENAME_MAX];
+	uint8_t header[INDEX_HEADER_SIZE];
+	uint8_t* keys;
+	if (index_path(movie, path, sizeof(path)))
+		return;
+
+	long len = read_file(path, header, INDEX_HEADER_SIZE, &keys, 1);
+	if (len < 0)
+		return;
+
+	uint32_t count = get(header + 32, 4);
+	if (memcmp(header, MOVIE_INDEX_MAGIC, 4) ||
+	    get(header + 4, 2) != MOVIE_INDEX_VERSION ||
+	    get(header + 8, 4) != movie->rom ||
+	    get(header + 12, 4) != movie->frames ||
+	    get(header + 16, 8) != movie->checksum ||
+	    get(header + 24, 4) != MOVIE_KEYFRAME_INTERVAL ||
+	    get(header + 28, 4) != movie->state_size ||
+	    count != movie->frames / MOVIE_KEYFRAME_INTERVAL + 1) {
+		LOG(INFO, "Movie index %s is out of date", path);
+		free(keys);
+		return;
+	}
+
+	// Check that the keyframes fill the file exactly, and that each
+	// one applies cleanly to the state before it.
+	uint8_t* state = calloc(1, movie->state_size);
+	if (state == NULL) {
+		LOG(ERROR, "Failed to allocate movie keyframe");
+		free(keys);
+		return;
+	}
+
+	size_t pos = 0;
+	uint32_t found = 0;
+	for (; found < count && pos + 4 <= (size_t)len; found++) {
+		size_t key = get(keys + pos, 4);
+		if (key > (size_t)len - pos - 4 ||
+		    delta_apply(state, movie->state_size, keys + pos + 4, key))
+			break;
+		pos += 4 + key;
+	}
+	free(state);
+	if (found != count || pos != (size_t)len) {
+		LOG(ERROR, "Movie index %s is corrupt", path);
+		free(keys);
+		return;
+	}
+
+	movie->keys      = keys;
+	movie->keys_len  = movie->keys_cap = len;
+	movie->key_count = count;
+	movie->indexed   = 1;
+	LOG(INFO, "Loaded movie index with %u keyframes", count);
+}
+
+static movie_t* alloc(const char* path, enum movie_mode mode, machine_t* machine)
+{
+	movie_t* movie = malloc(sizeof(movie_t));
+	if (movie == NULL) {
+		LOG(ERROR, "Failed to allocate movie");
+		return NULL;
+	}
+	memset(movie, 0, sizeof(movie_t));
+	movie->path       = path;
+	movie->mode       = mode;
+	movie->rom        = machine->bus.mapper->checksum;
+	movie->state_size = machine_state_size(machine);
+	return movie;
+}
+
+movie_t* movie_create(const char* path, machine_t* machine, uint8_t sync)
+{
+	movie_t* movie = alloc(path, MOVIE_RECORD, machine);
+	if (movie == NULL)
+		return NULL;
+
+	movie->sync = sync;
+	return movie;
+}
+
+movie_t* movie_load(const char* path, machine_t* machine)
+{
+	movie_t* movie = alloc(path, MOVIE_PLAY, machine);
+	if (movie == NULL)
+		return NULL;
+
+	uint8_t header[HEADER_SIZE];
+	long len = read_file(path, header, HEADER_SIZE, &movie->data, 0);
+	if (len < 0)
+		goto fail;
+	movie->len = movie->cap = len;
+
+	if (memcmp(header, MOVIE_MAGIC, 4)) {
+		LOG(ERROR, "Not a movie: %s", path);
+		goto fail;
+	}
+
+	uint16_t version = get(header + 4, 2);
+	if (version != MOVIE_VERSION) {
+		LOG(ERROR, "Unsupported movie version %u", version);
+		goto fail;
+	}
+
+	movie->sync     = header[6];
+	movie->frames   = get(header + 12, 4);
+	movie->checksum = get(header + 16, 8);
+
+	if (movie->sync > SYNC_CATCHUP) {
+		LOG(ERROR, "Movie has unknown sync mode %u", movie->sync);
+		goto fail;
+	}
+
+	if (get(header + 8, 4) != movie->rom) {
+		LOG(ERROR, "Movie was recorded with another ROM");
+		goto fail;
+	}
+
+	load_index(movie);
+	return movie;
+
+fail:
+	movie_destroy(movie);
+	return NULL;
+}
+
+void movie_destroy(movie_t* movie)
+{
+	free(movie->data);
+	free(movie->keys);
+	free(movie->key_state);
+	free(movie->key_next);
+	free(movie->key_delta);
+	free(movie);
+}
+
+int movie_record(movie_t* movie, movie_input_t input)
+{
+	// A reset always starts a run, as it only applies to the first
+	// frame of one.
+	if (movie->run && !input.reset &&
+	    input.joy1 == movie->input.joy1 && input.joy2 == movie->input.joy2 &&
+	    movie->run < UINT32_MAX) {
+		movie->run++;
+	} else {
+		if (flush(movie))
+			return -1;
+		movie->input = input;
+		movie->run   = 1;
+	}
+	movie->frame++;
+	return 0;
+}
+
+int movie_play(movie_t* movie, movie_input_t* input)
+{
+	if (movie->frame == movie->frames)
+		return -1;
+
+	if (!movie->run && next(movie)) {
+		LOG(ERROR, "Movie is corrupt at frame %u", movie->frame);
+		return -1;
+	}
+
+	*input = movie->input;
+	movie->input.reset = 0;
+	movie->run--;
+	movie->frame++;
+	return 0;
+}
+
+int movie_keyframe(movie_t* movie, machine_t* machine)
+{
+	if (movie->indexed ||
+	    movie->frame != movie->key_count * MOVIE_KEYFRAME_INTERVAL)
+		return 0;
+
+	// The first keyframe is encoded against zeros.
+	if (movie->key_state == NULL) {
+		movie->key_state = calloc(1, movie->state_size);
+		movie->key_next  = malloc(movie->state_size);
+		movie->key_delta = malloc(DELTA_MAX_SIZE(movie->state_size));
+		if (!movie->key_state || !movie->key_next || !movie->key_delta) {
+			LOG(ERROR, "Failed to allocate movie index");
+			free(movie->key_state);
+			free(movie->key_next);
+			free(movie->key_delta);
+			movie->key_state = movie->key_next = movie->key_delta = NULL;
+			return -1;
+		}
+	}
+
+	machine_save(machine, movie->key_next);
+	size_t len = delta_encode(movie->key_state, movie->key_next,
+		movie->state_size, movie->key_delta);
+
+	if (reserve(&movie->keys, &movie->keys_cap, movie->keys_len, 4 + len))
+		return -1;
+	put(movie->keys + movie->keys_len, len, 4);
+	memcpy(movie->keys + movie->keys_len + 4, movie->key_delta, len);
+	movie->keys_len += 4 + len;
+
+	uint8_t* state = movie->key_state;
+	movie->key_state = movie->key_next;
+	movie->key_next  = state;
+	movie->key_count++;
+	return 0;
+}
+
+// drop_index discards a movie's index, so that it is played without
+// one.
+static void drop_index(movie_t* movie)
+{
+	free(movie->keys);
+	movie->keys      = NULL;
+	movie->keys_len  = movie->keys_cap = 0;
+	movie->key_count = 0;
+	movie->indexed   = 0;
+}
+
+int movie_seek(movie_t* movie, machine_t* machine, uint32_t frame)
+{
+	if (frame > movie->frames) {
+		LOG(ERROR, "Cannot seek past the end of the movie (%u frames)", movie->frames);
+		return -1;
+	}
+
+	if (movie->indexed) {
+		uint8_t* state = calloc(1, movie->state_size);
+		if (state == NULL) {
+			LOG(ERROR, "Failed to allocate movie keyframe");
+			return -1;
+		}
+
+		uint32_t key = frame / MOVIE_KEYFRAME_INTERVAL;
+		const uint8_t* in = movie->keys;
+		const uint8_t* end = movie->keys + movie->keys_len;
+		uint32_t i = 0;
+		for (; i <= key && in + 4 <= end; i++) {
+			size_t len = get(in, 4);
+			if (len > (size_t)(end - in) - 4 ||
+			    delta_apply(state, movie->state_size, in + 4, len))
+				break;
+			in += 4 + len;
+		}
+
+		if (i > key) {
+			machine_restore(machine, state);
+			free(state);
+			if (locate(movie, key * MOVIE_KEYFRAME_INTERVAL)) {
+				LOG(ERROR, "Movie is corrupt at frame %u", movie->frame);
+				return -1;
+			}
+			return 0;
+		}
+
+		// The machine is left as it was.
+		free(state);
+		LOG(ERROR, "Movie index is corrupt; seeking without it");
+		drop_index(movie);
+	}
+
+	if (frame < movie->frame) {
+		LOG(ERROR, "Cannot seek back in a movie without an index");
+		return -1;
+	}
+	return 0;
+}
+
+int movie_save(movie_t* movie, uint64_t checksum)
+{
+	if (flush(movie)) {
+		LOG(ERROR, "Movie %s is incomplete; not saved", movie->path);
+		return -1;
+	}
+
+	uint8_t header[HEADER_SIZE] = {0};
+	memcpy(header, MOVIE_MAGIC, 4);
+	put(header + 4, MOVIE_VERSION, 2);
+	header[6] = movie->sync;
+	put(header + 8, movie->rom, 4);
+	put(header + 12, movie->frame, 4);
+	put(header + 16, checksum, 8);
+
+	if (write_file(movie->path, header, HEADER_SIZE, movie->data, movie->len))
+		return -1;
+
+	movie->frames   = movie->frame;
+	movie->checksum = checksum;
+
+	// The movie is complete without its index.
+	movie_save_index(movie);
+	return 0;
+}
+
+int movie_save_index(movie_t* movie)
+{
+	char path[FILENAME_MAX];
+	if (movie->key_count != movie->frames / MOVIE_KEYFRAME_INTERVAL + 1 ||
+	    index_path(movie, path, sizeof(path)))
+		return -1;
+
+	uint8_t header[INDEX_HEADER_SIZE] = {0};
+	memcpy(header, MOVIE_INDEX_MAGIC, 4);
+	put(header + 4, MOVIE_INDEX_VERSION, 2);
+	put(header + 8, movie->rom, 4);
+	put(header + 12, movie->frames, 4);
+	put(header + 16, movie->checksum, 8);
+	put(header + 24, MOVIE_KEYFRAME_INTERVAL, 4);
+	put(header + 28, movie->state_size, 4);
+	put(header + 32, movie->key_count, 4);
+
+	if (write_file(path, header, INDEX_HEADER_SIZE, movie->keys, movie->keys_len))
+		return -1;
+
+	LOG(INFO, "Wrote movie index %s (%u keyframes, %.1f KB)", path,
+	    movie->key_count, (double)movie->keys_len / 1024);
+	return 0;
+}
@@ -0,0 +1,132 @@
+#ifndef NES_TOOLS_MOVIE_H
+#define NES_TOOLS_MOVIE_H
+
+#include "system.h"
+#include "machine.h"
+
+// A movie is the input of every frame of a session, from power-on, so
+// that the session can be replayed exactly. The file is a header
+// followed by runs of frames with the same input. Each run is a varint
+// count of frames, a byte of MOVIE_* flags and the status of both
+// joypads (16 bits each). Integers are stored little-endian.
+
+#define MOVIE_MAGIC   "NESM"
+#define MOVIE_VERSION 2
+
+// Flags of a run: the machine is reset before its first frame.
+#define MOVIE_RESET BIT_0
+
+// A movie's index holds keyframes: the machine's state every
+// MOVIE_KEYFRAME_INTERVAL frames from power-on, each encoded as its
+// delta with the one before (see delta.h). It is kept next to the
+// movie, in "<movie>.idx", and lets playback start at any frame after
+// emulating at most MOVIE_KEYFRAME_INTERVAL frames. The file is a
+// header followed by the keyframes, each a 32-bit length and the
+// delta.
+#define MOVIE_INDEX_MAGIC   "NESI"
+#define MOVIE_INDEX_VERSION 1
+#define MOVIE_KEYFRAME_INTERVAL 600
+
+enum movie_mode
+{
+	MOVIE_RECORD = 0,
+	MOVIE_PLAY
+};
+
+// movie_input_t is the input of one frame.
+typedef struct
+{
+	uint16_t joy1;
+	uint16_t joy2;
+	uint8_t  reset;
+
+} movie_input_t;
+
+// movie_t is a movie being recorded or played back.
+typedef struct
+{
+	enum movie_mode mode;
+	const char*     path;
+
+	// Checksum of the ROM (see mapper_t), and the emu_sync mode the
+	// movie was recorded with.
+	uint32_t rom;
+	uint8_t  sync;
+
+	// Number of frames in the movie, and the checksum of the machine's
+	// state after the last one (see machine_checksum).
+	uint32_t frames;
+	uint64_t checksum;
+
+	// Encoded runs. Playback reads them from pos. error is set if
+	// memory for them ran out while recording.
+	uint8_t* data;
+	size_t   len;
+	size_t   cap;
+	size_t   pos;
+	uint8_t  error;
+
+	// The run being recorded or played: its input, and the number of
+	// frames recorded so far or left to play.
+	movie_input_t input;
+	uint32_t      run;
+
+	// Frames recorded or played so far.
+	uint32_t frame;
+
+	// Keyframes of the index, as stored in its file. indexed is set if
+	// the index was loaded; otherwise it is built as the movie is
+	// recorded or played from the start, from key_state, the newest
+	// keyframe.
+	uint8_t* keys;
+	size_t   keys_len;
+	size_t   keys_cap;
+	uint32_t key_count;
+	uint8_t  indexed;
+	size_t   state_size;
+	uint8_t* key_state;
+	uint8_t* key_next;
+	uint8_t* key_delta;
+
+} movie_t;
+
+// movie_create starts recording a movie of machine, from power-on, to
+// be written to path by movie_save.
+movie_t* movie_create(const char* path, machine_t* machine, uint8_t sync);
+
+// movie_load reads the movie at path, and its index if there is an up
+// to date one, for playback on machine. It fails if the movie was
+// recorded with another ROM.
+movie_t* movie_load(const char* path, machine_t* machine);
+void movie_destroy(movie_t* movie);
+
+// movie_record appends a frame to a movie being recorded. It returns
+// 0, or -1 if memory ran out; the movie can then not be saved.
+int movie_record(movie_t* movie, movie_input_t input);
+
+// movie_play reads the input of the next frame of a movie being played
+// back. It returns 0, or -1 once the movie has ended.
+int movie_play(movie_t* movie, movie_input_t* input);
+
+// movie_keyframe is called after each frame: if the movie's index is
+// being built and a keyframe is due, it records machine's state. It
+// returns -1 if memory ran out; no index is written then, but the
+// movie itself is unaffected.
+int movie_keyframe(movie_t* movie, machine_t* machine);
+
+// movie_seek restores machine to the last keyframe at or before frame,
+// and plays the movie from there. Without an index, it leaves both as
+// they are, if they have not passed frame. It returns 0 on success;
+// the frames up to frame remain to be played.
+int movie_seek(movie_t* movie, machine_t* machine, uint32_t frame);
+
+// movie_save writes a recorded movie to its file, along with the
+// checksum of the machine's state after its last frame, and writes its
+// index. It returns 0 on success.
+int movie_save(movie_t* movie, uint64_t checksum);
+
+// movie_save_index writes the index built while playing the whole of
+// a movie back. It returns 0 on success.
+int movie_save_index(movie_t* movie);
+
+#endif // NES_TOOLS_MOVIE_H
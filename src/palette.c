@@ -0,0 +1,212 @@
+#include "palette.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PALETTE_X86
+#include <immintrin.h>
+#endif
+
+// Attenuation applied to the colour channels that are not emphasized.
+#define EMPHASIS_ATTENUATION 0.816328
+
+// ARGB8888 palette
+static const uint32_t palette_raw[PALETTE_COLOURS] =
+{
+	0xff666666, 0xff002a88, 0xff1412a7, 0xff3b00a4,
+	0xff5c007e, 0xff6e0040, 0xff6c0600, 0xff561d00,
+	0xff333500, 0xff0b4800, 0xff005200, 0xff004f08,
+	0xff00404d, 0xff000000, 0xff000000, 0xff000000,
+	0xffadadad, 0xff155fd9, 0xff4240ff, 0xff7527fe,
+	0xffa01acc, 0xffb71e7b, 0xffb53120, 0xff994e00,
+	0xff6b6d00, 0xff388700, 0xff0c9300, 0xff008f32,
+	0xff007c8d, 0xff000000, 0xff000000, 0xff000000,
+	0xfffffeff, 0xff64b0ff, 0xff9290ff, 0xffc676ff,
+	0xfff36aff, 0xfffe6ecc, 0xfffe8170, 0xffea9e22,
+	0xffbcbe00, 0xff88d800, 0xff5ce430, 0xff45e082,
+	0xff48cdde, 0xff4f4f4f, 0xff000000, 0xff000000,
+	0xfffffeff, 0xffc0dfff, 0xffd3d2ff, 0xffe8c8ff,
+	0xfffbc2ff, 0xfffec4ea, 0xfffeccc5, 0xfff7d8a5,
+	0xffe4e594, 0xffcfef96, 0xffbdf4ab, 0xffb3f3cc,
+	0xffb5ebf2, 0xffb8b8b8, 0xff000000, 0xff000000,
+};
+
+void palette_init(palette_t* pal, enum tv_system type)
+{
+	for (int e = 0; e < PALETTE_EMPHASIS; e++) {
+		// PPU_MASK bit 5 emphasizes red on NTSC and green on PAL,
+		// bit 6 the other one, and bit 7 blue.
+		uint8_t red   = (type == PAL) ? (e & 2) : (e & 1);
+		uint8_t green = (type == PAL) ? (e & 1) : (e & 2);
+		uint8_t blue  = e & 4;
+
+		for (int c = 0; c < PALETTE_COLOURS; c++) {
+			double rgb[3] = {
+				(palette_raw[c] >> 16) & 0xff,
+				(palette_raw[c] >> 8) & 0xff,
+				palette_raw[c] & 0xff
+			};
+
+			if (e) {
+				if (!red)   rgb[0] *= EMPHASIS_ATTENUATION;
+				if (!green) rgb[1] *= EMPHASIS_ATTENUATION;
+				if (!blue)  rgb[2] *= EMPHASIS_ATTENUATION;
+			}
+
+			uint32_t r = (uint32_t)(rgb[0] + 0.5);
+			uint32_t g = (uint32_t)(rgb[1] + 0.5);
+			uint32_t b = (uint32_t)(rgb[2] + 0.5);
+
+			pal->rgba[e << 6 | c] = 0xff000000 | (b << 16) | (g << 8) | r;
+			pal->rgb565[e << 6 | c] = ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3);
+		}
+	}
+	pal->rgb565[PALETTE_SIZE] = 0;
+
+	pal->isa = PALETTE_SCALAR;
+#ifdef PALETTE_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		pal->isa = PALETTE_AVX2;
+	else if (__builtin_cpu_supports("sse2"))
+		pal->isa = PALETTE_SSE2;
+#endif
+}
+
+// Scalar conversion of pixels [x, width) of a line; also used for the
+// tails the vector loops leave behind.
+static void rgba_line_scalar
+(const uint32_t* lut, const uint8_t* in, int x, int width, uint32_t* out)
+{
+	for (; x < width; x++)
+		out[x] = lut[in[x] & 0x3f];
+}
+
+static void rgb565_line_scalar
+(const uint16_t* lut, const uint8_t* in, int x, int width, uint16_t* out)
+{
+	for (; x < width; x++)
+		out[x] = lut[in[x] & 0x3f];
+}
+
+#ifdef PALETTE_X86
+
+// SSE2 has no gather: look the colours up 4 at a time and write them
+// with full-width stores.
+__attribute__((target("sse2")))
+static void rgba_line_sse2
+(const uint32_t* lut, const uint8_t* in, int width, uint32_t* out)
+{
+	int x = 0;
+	for (; x + 4 <= width; x += 4) {
+		__m128i px = _mm_setr_epi32(
+			lut[in[x] & 0x3f], lut[in[x + 1] & 0x3f],
+			lut[in[x + 2] & 0x3f], lut[in[x + 3] & 0x3f]);
+		_mm_storeu_si128((__m128i*)(out + x), px);
+	}
+	rgba_line_scalar(lut, in, x, width, out);
+}
+
+__attribute__((target("sse2")))
+static void rgb565_line_sse2
+(const uint16_t* lut, const uint8_t* in, int width, uint16_t* out)
+{
+	int x = 0;
+	for (; x + 8 <= width; x += 8) {
+		__m128i px = _mm_setr_epi16(
+			lut[in[x] & 0x3f], lut[in[x + 1] & 0x3f],
+			lut[in[x + 2] & 0x3f], lut[in[x + 3] & 0x3f],
+			lut[in[x + 4] & 0x3f], lut[in[x + 5] & 0x3f],
+			lut[in[x + 6] & 0x3f], lut[in[x + 7] & 0x3f]);
+		_mm_storeu_si128((__m128i*)(out + x), px);
+	}
+	rgb565_line_scalar(lut, in, x, width, out);
+}
+
+// AVX2 widens 8 indices to 32 bits and gathers their colours at once.
+__attribute__((target("avx2")))
+static void rgba_line_avx2
+(const uint32_t* lut, const uint8_t* in, int width, uint32_t* out)
+{
+	const __m256i mask = _mm256_set1_epi32(0x3f);
+	int x = 0;
+	for (; x + 8 <= width; x += 8) {
+		__m256i idx = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(in + x)));
+		idx = _mm256_and_si256(idx, mask);
+		__m256i px = _mm256_i32gather_epi32((const int*)lut, idx, 4);
+		_mm256_storeu_si256((__m256i*)(out + x), px);
+	}
+	rgba_line_scalar(lut, in, x, width, out);
+}
+
+__attribute__((target("avx2")))
+static void rgb565_line_avx2
+(const uint16_t* lut, const uint8_t* in, int width, uint16_t* out)
+{
+	const __m256i mask = _mm256_set1_epi32(0x3f);
+	const __m256i low = _mm256_set1_epi32(0xffff);
+	int x = 0;
+	for (; x + 16 <= width; x += 16) {
+		__m256i lo = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(in + x)));
+		__m256i hi = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(in + x + 8)));
+		lo = _mm256_and_si256(lo, mask);
+		hi = _mm256_and_si256(hi, mask);
+
+		// Gather 32 bits at each 16-bit entry and keep the low half.
+		lo = _mm256_and_si256(_mm256_i32gather_epi32((const int*)lut, lo, 2), low);
+		hi = _mm256_and_si256(_mm256_i32gather_epi32((const int*)lut, hi, 2), low);
+
+		// packus interleaves the 128-bit lanes; put them back in order.
+		__m256i px = _mm256_permute4x64_epi64(_mm256_packus_epi32(lo, hi), 0xd8);
+		_mm256_storeu_si256((__m256i*)(out + x), px);
+	}
+	rgb565_line_scalar(lut, in, x, width, out);
+}
+
+#endif // PALETTE_X86
+
+void palette_convert_rgba(const palette_t* pal, const uint8_t* screen,
+	const uint8_t* emphasis, int width, int height, uint32_t* out)
+{
+	for (int y = 0; y < height; y++) {
+		const uint32_t* lut = pal->rgba + ((emphasis[y] & 7) << 6);
+		const uint8_t* in = screen + y * width;
+		uint32_t* line = out + y * width;
+
+		switch (pal->isa) {
+#ifdef PALETTE_X86
+		case PALETTE_AVX2:
+			rgba_line_avx2(lut, in, width, line);
+			break;
+		case PALETTE_SSE2:
+			rgba_line_sse2(lut, in, width, line);
+			break;
+#endif
+		default:
+			rgba_line_scalar(lut, in, 0, width, line);
+			break;
+		}
+	}
+}
+
+void palette_convert_rgb565(const palette_t* pal, const uint8_t* screen,
+	const uint8_t* emphasis, int width, int height, uint16_t* out)
+{
+	for (int y = 0; y < height; y++) {
+		const uint16_t* lut = pal->rgb565 + ((emphasis[y] & 7) << 6);
+		const uint8_t* in = screen + y * width;
+		uint16_t* line = out + y * width;
+
+		switch (pal->isa) {
+#ifdef PALETTE_X86
+		case PALETTE_AVX2:
+			rgb565_line_avx2(lut, in, width, line);
+			break;
+		case PALETTE_SSE2:
+			rgb565_line_sse2(lut, in, width, line);
+			break;
+#endif
+		default:
+			rgb565_line_scalar(lut, in, 0, width, line);
+			break;
+		}
+	}
+}
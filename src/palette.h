@@ -0,0 +1,53 @@
+#ifndef NES_TOOLS_PALETTE_H
+#define NES_TOOLS_PALETTE_H
+
+#include "system.h"
+#include "mapper.h"
+
+// The PPU draws 6-bit colour indices. Each scanline also records the
+// colour emphasis bits of PPU_MASK, which select one of 8 variants of
+// the 64-colour palette.
+#define PALETTE_COLOURS  64
+#define PALETTE_EMPHASIS 8
+#define PALETTE_SIZE     (PALETTE_COLOURS * PALETTE_EMPHASIS)
+
+// palette_isa enumerates the instruction sets palette_convert_* can
+// use, from slowest to fastest.
+enum palette_isa
+{
+	PALETTE_SCALAR = 0,
+	PALETTE_SSE2,
+	PALETTE_AVX2
+};
+
+// palette_t holds the lookup tables that turn an indexed PPU frame
+// into displayable pixels. Tables are indexed by emphasis << 6 | colour.
+typedef struct
+{
+	// ABGR8888 (byte order R, G, B, A), the emulator's texture format.
+	uint32_t rgba[PALETTE_SIZE];
+
+	// RGB565, padded by one entry so that 32-bit gathers stay in
+	// bounds.
+	uint16_t rgb565[PALETTE_SIZE + 1];
+
+	enum palette_isa isa;
+
+} palette_t;
+
+// palette_init builds the lookup tables for the given TV system (PAL
+// swaps the red and green emphasis bits) and picks the fastest
+// instruction set supported by the host.
+void palette_init(palette_t* pal, enum tv_system type);
+
+// palette_convert_rgba converts a frame of width * height colour
+// indices, with one emphasis value per line, to ABGR8888 pixels.
+void palette_convert_rgba(const palette_t* pal, const uint8_t* screen,
+	const uint8_t* emphasis, int width, int height, uint32_t* out);
+
+// palette_convert_rgb565 converts a frame of colour indices to RGB565
+// pixels, as palette_convert_rgba.
+void palette_convert_rgb565(const palette_t* pal, const uint8_t* screen,
+	const uint8_t* emphasis, int width, int height, uint16_t* out);
+
+#endif // NES_TOOLS_PALETTE_H
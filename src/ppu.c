@@ -1,43 +1,12 @@
 #include "ppu.h"
 #include "cpu6502.h"
+#include "machine.h"
 
-const size_t screen_size = sizeof(uint32_t) * VISIBLE_SCANLINES * VISIBLE_DOTS;
-uint32_t ppu_palette[64];
+const size_t screen_size = VISIBLE_SCANLINES * VISIBLE_DOTS;
 
-static void to_pixel_format
-(const uint32_t* in, uint32_t* out, size_t size, uint32_t format)
+void ppu_init(ppu_t* ppu)
 {
-	for(int i = 0; i < size; i++) {
-		switch (format) {
-		case SDL_PIXELFORMAT_ARGB8888:{
-			out[i] = in[i];
-			break;
-		}
-		case SDL_PIXELFORMAT_ABGR8888:{
-			out[i] = (in[i] & 0xff000000) |
-				((in[i] << 16) & 0x00ff0000) |
-				(in[i] & 0x0000ff00) |
-				((in[i] >> 16) & 0x000000ff);
-
-			break;
-		}
-		default:
-			LOG(DEBUG, "Unsupported format");
-			exit(EXIT_FAILURE);
-		}
-	}
-}
-
-ppu_t* ppu_create(bus_t* bus)
-{
-	to_pixel_format(ppu_palette_raw, ppu_palette, 64,
-                SDL_PIXELFORMAT_ABGR8888);
-
-	ppu_t* ppu = malloc(sizeof(ppu_t));
-	ppu->screen = malloc(screen_size);
-	ppu->bus = bus;
-
-	ppu->scanlines_per_frame = bus->mapper->type == NTSC ?
+	ppu->scanlines_per_frame = ppu_bus(ppu)->mapper->type == NTSC ?
 		NTSC_SCANLINES_PER_FRAME : PAL_SCANLINES_PER_FRAME;
 
 	memset(ppu->palette, 0, sizeof(ppu->palette));
@@ -45,17 +14,11 @@ ppu_t* ppu_create(bus_t* bus)
 	memset(ppu->v_ram, 0, sizeof(ppu->v_ram));
 	memset(ppu->oam, 0, sizeof(ppu->oam));
 
-	ppu->oam_addr = 0;
-	ppu->v = 0;
+	ppu->oam_addr  = 0;
+	ppu->v         = 0;
+	ppu->pal_cycle = 0;
+	ppu->cycles    = 0;
 	ppu_reset(ppu);
-
-	return ppu;
-}
-
-void ppu_destroy(ppu_t* ppu)
-{
-	free(ppu->screen);
-	free(ppu);
 }
 
 void ppu_reset(ppu_t* ppu)
@@ -68,9 +31,12 @@ void ppu_reset(ppu_t* ppu)
 	ppu->status        = 0;
 	ppu->frames        = 0;
 	ppu->oam_cache_len = 0;
+	ppu->line_x        = 0;
 
 	memset(ppu->oam_cache, 0, 8);
-	memset(ppu->screen, 0, screen_size);
+	memset(ppu->sprite_line, 0, sizeof(ppu->sprite_line));
+	memset(ppu_screen(ppu), 0, screen_size);
+	memset(ppu_emphasis(ppu), 0, VISIBLE_SCANLINES);
 }
 
 uint8_t ppu_read_status(ppu_t* ppu)
@@ -108,17 +74,16 @@ void ppu_write(ppu_t* ppu, uint8_t val)
 
 void ppu_dma(ppu_t* ppu, uint8_t addr)
 {
-	bus_t* bus = ppu->bus;
+	bus_t* bus = ppu_bus(ppu);
 	uint8_t* ptr = bus_get_ptr(bus, addr * 0x100);
 	if (ptr == NULL) {
-		// Probably in PRG ROM so it is not possible to
-		// resolve a pointer due to bank switching, so we do
-		// it the slow hard way.
+		// The page is not directly mapped (e.g. IO registers),
+		// so we do it the slow hard way.
 		for (int i = 0; i < 256; i++) {
 			ppu->oam[(ppu->oam_addr + i) & 0xff] = bus_read(bus, addr * 0x100 + i);
 		}
 
-		cpu_dma_suspend(ppu->bus->cpu);
+		cpu_dma_suspend(ppu_bus(ppu)->cpu);
 		return;
 	}
 
@@ -131,9 +96,9 @@ void ppu_dma(ppu_t* ppu, uint8_t addr)
 		memcpy(ppu->oam, ptr + (256 - ppu->oam_addr), ppu->oam_addr);
 
 	// Last value.
-	bus->bus = ptr[255];
+	bus->data->bus = ptr[255];
 
-	cpu_dma_suspend(ppu->bus->cpu);
+	cpu_dma_suspend(ppu_bus(ppu)->cpu);
 }
 
 void ppu_set_scroll(ppu_t* ppu, uint8_t val)
@@ -185,14 +150,14 @@ uint8_t ppu_read_vram(ppu_t* ppu, uint16_t addr)
 	ppu->ppu_bus = addr;
 
 	if (addr < 0x2000) {
-		ppu->ppu_bus = mapper_read_chr(ppu->bus->mapper, addr);
+		ppu->ppu_bus = mapper_read_chr(ppu_bus(ppu)->mapper, addr);
 		return ppu->ppu_bus;
 	}
 
 	if (addr < 0x3F00) {
 		addr = (addr & 0xefff) - 0x2000;
 		ppu->ppu_bus = ppu->v_ram[
-			ppu->bus->mapper->nametable_map[addr / 0x400] +
+			ppu_bus(ppu)->mapper->nametable_map[addr / 0x400] +
 			(addr & 0x3ff)
 		];
 		return ppu->ppu_bus;
@@ -210,13 +175,13 @@ void ppu_write_vram(ppu_t* ppu, uint16_t addr, uint8_t val)
 	ppu->ppu_bus = val;
 
 	if (addr < 0x2000) {
-		mapper_write_chr(ppu->bus->mapper, addr, val);
+		mapper_write_chr(ppu_bus(ppu)->mapper, addr, val);
 		return;
 	}
 
 	if (addr < 0x3F00) {
 		addr = (addr & 0xefff) - 0x2000;
-		ppu->v_ram[ppu->bus->mapper->nametable_map[addr / 0x400]
+		ppu->v_ram[ppu_bus(ppu)->mapper->nametable_map[addr / 0x400]
 			   + (addr & 0x3ff)] = val;
 		return;
 	}
@@ -234,61 +199,72 @@ void ppu_write_vram(ppu_t* ppu, uint16_t addr, uint8_t val)
 	return;
 }
 
-static uint16_t render_background(ppu_t* ppu)
-{
-	int x = (int)ppu->dots - 1;
-	uint8_t fine_x = ((uint16_t)ppu->x + x) % 8;
-
-	if (!(ppu->mask & SHOW_BG_8) && x < 8)
-		return 0;
-
-	uint16_t tile_addr = 0x2000 | (ppu->v & 0xFFF);
-	uint16_t attr_addr = 0x23C0 | (ppu->v & 0x0C00) |
-		((ppu->v >> 4) & 0x38) | ((ppu->v >> 2) & 0x07);
-
-	uint16_t pattern_addr = (ppu_read_vram(ppu, tile_addr) * 16 +
-                ((ppu->v >> 12) & 0x7)) | ((ppu->ctrl & BG_TABLE) << 8);
+// Rendering fetches bypass ppu_read_vram: they never reach palette
+// memory and must not disturb the CPU-visible ppu_bus latch. Pattern
+// data comes pre-decoded from the mapper's tile cache.
+static inline const uint8_t* fetch_chr_row(ppu_t* ppu, uint16_t addr, uint8_t flip)
+{ return mapper_chr_row(ppu_bus(ppu)->mapper, addr, flip); }
 
-	uint16_t palette_addr = (ppu_read_vram(ppu, pattern_addr) >>
-                (7 ^ fine_x)) & 1;
+static inline uint8_t fetch_nametable(ppu_t* ppu, uint16_t addr)
+{
+	addr &= 0xfff;
+	return ppu->v_ram[ppu_bus(ppu)->mapper->nametable_map[addr / 0x400] +
+			  (addr & 0x3ff)];
+}
 
-	palette_addr |= ((ppu_read_vram(ppu, pattern_addr + 8) >>
-                (7 ^ fine_x)) & 1) << 1;
+// fetch_tile looks up the decoded pattern row of the background tile v
+// points at, and its palette bits (already shifted into place).
+static const uint8_t* fetch_tile(ppu_t* ppu, uint8_t* attr)
+{
+	uint16_t v = ppu->v;
+	uint16_t attr_addr = 0x23C0 | (v & 0x0C00) |
+		((v >> 4) & 0x38) | ((v >> 2) & 0x07);
 
-	if (!palette_addr)
-		return 0;
+	uint16_t pattern_addr = (fetch_nametable(ppu, 0x2000 | (v & 0xFFF)) * 16 +
+		((v >> 12) & 0x7)) | ((ppu->ctrl & BG_TABLE) << 8);
 
-	uint8_t attr = ppu_read_vram(ppu, attr_addr);
+	*attr = ((fetch_nametable(ppu, attr_addr) >>
+		  (((v >> 4) & 4) | (v & 2))) & 0x3) << 2;
+	return fetch_chr_row(ppu, pattern_addr, 0);
+}
 
-	return palette_addr |
-		(((attr >> (((ppu->v >> 4) & 4) | (ppu->v & 2))) & 0x3) << 2);
+// increment_x moves v to the next background tile.
+static void increment_x(ppu_t* ppu)
+{
+	if ((ppu->v & COARSE_X) == 31) {
+		ppu->v &= ~COARSE_X;
+		// switch horizontal nametable
+		ppu->v ^= 0x400;
+	}
+	else
+		ppu->v++;
 }
 
-static uint16_t render_sprites
-(ppu_t* restrict ppu, uint16_t bg_addr, uint8_t* restrict back_priority)
+// compose_sprites draws the sprites found by OAM evaluation on the
+// current scanline into sprite_line, for use on the next scanline.
+static void compose_sprites(ppu_t* ppu)
 {
 	// 4 bytes per sprite
 	// byte 0 -> y index
 	// byte 1 -> tile index
 	// byte 2 -> render info
 	// byte 3 -> x index
-	int x = (int)ppu->dots - 1, y = (int)ppu->scanlines;
-	uint16_t palette_addr = 0;
 	uint8_t length = ppu->ctrl & LONG_SPRITE ? 16: 8;
-	for(int j = 0; j < ppu->oam_cache_len; j++) {
+	memset(ppu->sprite_line, 0, sizeof(ppu->sprite_line));
+
+	// Draw back to front so that lower OAM indices end up on top.
+	for (int j = ppu->oam_cache_len - 1; j >= 0; j--) {
 		int i = ppu->oam_cache[j];
+		uint16_t tile = ppu->oam[i + 1];
+		uint8_t attr = ppu->oam[i + 2];
 		uint8_t tile_x = ppu->oam[i + 3];
+		int y_off = (int)ppu->scanlines - ppu->oam[i];
 
-		if (x - tile_x < 0 || x - tile_x >= 8)
+		// A stale cache (rendering was disabled) may not cover
+		// this scanline.
+		if (y_off < 0 || y_off >= length)
 			continue;
 
-		uint16_t tile = ppu->oam[i + 1];
-		uint8_t tile_y = ppu->oam[i] + 1;
-		uint8_t attr = ppu->oam[i + 2];
-		int x_off = (x - tile_x) % 8, y_off = (y - tile_y) % length;
-
-		if (!(attr & FLIP_HORIZONTAL))
-			x_off ^= 7;
 		if (attr & FLIP_VERTICAL)
 			y_off ^= (length - 1);
 
@@ -303,58 +279,100 @@ static uint16_t render_sprites
 				(ppu->ctrl & SPRITE_TABLE ? 0x1000 : 0);
 		}
 
-		palette_addr = (ppu_read_vram(ppu, tile_addr) >> x_off) & 1;
-		palette_addr |= ((ppu_read_vram(ppu, tile_addr + 8) >> x_off) & 1) << 1;
+		const uint8_t* row = fetch_chr_row(ppu, tile_addr, attr & FLIP_HORIZONTAL);
+		uint8_t pixel = 0x10 | ((attr & 0x3) << 2) |
+			((attr & BIT_5) ? SPRITE_BEHIND_BG : 0);
 
-		if (!palette_addr)
-			continue;
+		for (int k = 0; k < 8 && tile_x + k < VISIBLE_DOTS; k++) {
+			if (!row[k])
+				continue;
 
-		palette_addr |= 0x10 | ((attr & 0x3) << 2);
-		*back_priority = attr & BIT_5;
-
-		// Sprite hit evaluation.
-		if (!(ppu->status & SPRITE_0_HIT)
-		    && (ppu->mask & SHOW_BG)
-		    && i == 0
-		    && palette_addr
-		    && bg_addr
-		    && x < 255)
-			ppu->status |= SPRITE_0_HIT;
-		break;
+			uint8_t* out = &ppu->sprite_line[tile_x + k];
+			*out = (*out & SPRITE_ZERO) | pixel | row[k] |
+				(i == 0 ? SPRITE_ZERO : 0);
+		}
 	}
-
-	return palette_addr;
 }
 
-void ppu_exec(ppu_t* ppu)
+// render_span draws the pixels of the current scanline from line_x up
+// to (but excluding) end. Pixels are drawn a tile at a time: each
+// background tile is fetched once, and v steps through the tiles
+// exactly as it would dot by dot.
+static void render_span(ppu_t* ppu, int end)
 {
-	if (ppu->scanlines < VISIBLE_SCANLINES) {
-		// render scanlines 0 - 239
-		if (ppu->dots > 0 && ppu->dots <= VISIBLE_DOTS) {
-			int x = (int)ppu->dots - 1;
-			uint8_t fine_x = ((uint16_t)ppu->x + x) % 8, palette_addr = 0, palette_addr_sp = 0, back_priority = 0;
-
-			if (ppu->mask & SHOW_BG) {
-				palette_addr = render_background(ppu);
-				if (fine_x == 7) {
-					if ((ppu->v & COARSE_X) == 31) {
-						ppu->v &= ~COARSE_X;
-						// switch horizontal nametable
-						ppu->v ^= 0x400;
-					}
-					else
-						ppu->v++;
-				}
+	uint8_t* line = ppu_screen(ppu) + ppu->scanlines * VISIBLE_DOTS;
+	uint8_t mask = ppu->mask;
+
+	// Greyscale keeps only the luma column of the palette.
+	uint8_t colour_mask = (mask & GREYSCALE) ? 0x30 : 0x3f;
+	ppu_emphasis(ppu)[ppu->scanlines] = mask >> 5;
+
+	// First pixel at which each layer is visible (VISIBLE_DOTS: hidden).
+	int bg_start = !(mask & SHOW_BG) ? VISIBLE_DOTS : (mask & SHOW_BG_8) ? 0 : 8;
+	int sp_start = !(mask & SHOW_SPRITE) ? VISIBLE_DOTS : (mask & SHOW_SPRITE_8) ? 0 : 8;
+
+	int x = ppu->line_x;
+	while (x < end) {
+		// Tile-aligned position of x, and the end of the tile's pixels.
+		int tile_x = x - ((uint16_t)ppu->x + x) % 8;
+		int stop = tile_x + 8;
+		if (stop > end)
+			stop = end;
+
+		const uint8_t* row = NULL;
+		uint8_t attr = 0;
+		if (mask & SHOW_BG)
+			row = fetch_tile(ppu, &attr);
+
+		for (; x < stop; x++) {
+			uint8_t palette_addr = 0;
+			if (x >= bg_start) {
+				palette_addr = row[x - tile_x];
+				if (palette_addr)
+					palette_addr |= attr;
 			}
-			if (ppu->mask & SHOW_SPRITE && ((ppu->mask & SHOW_SPRITE_8) || x >=8)) {
-				palette_addr_sp = render_sprites(ppu, palette_addr, &back_priority);
+
+			if (x >= sp_start) {
+				uint8_t sprite = ppu->sprite_line[x];
+				if (sprite) {
+					// Sprite hit evaluation.
+					if ((sprite & SPRITE_ZERO) && palette_addr && x < 255)
+						ppu->status |= SPRITE_0_HIT;
+
+					if (!palette_addr || !(sprite & SPRITE_BEHIND_BG))
+						palette_addr = sprite & 0x1f;
+				}
 			}
-			if ((!palette_addr && palette_addr_sp) || (palette_addr && palette_addr_sp && !back_priority))
-				palette_addr = palette_addr_sp;
 
-			palette_addr = ppu->palette[palette_addr];
-			ppu->screen[ppu->scanlines * VISIBLE_DOTS + ppu->dots - 1] = ppu_palette[palette_addr];
+			line[x] = ppu->palette[palette_addr] & colour_mask;
 		}
+
+		if ((mask & SHOW_BG) && x == tile_x + 8)
+			increment_x(ppu);
+	}
+
+	if (end > ppu->line_x)
+		ppu->line_x = end;
+}
+
+void ppu_flush(ppu_t* ppu)
+{
+	if (ppu->scanlines >= VISIBLE_SCANLINES || ppu->dots < 2)
+		return;
+
+	// Dots 1 to dots - 1 have been executed.
+	render_span(ppu, (ppu->dots - 1 < VISIBLE_DOTS) ?
+		    (int)ppu->dots - 1 : VISIBLE_DOTS);
+}
+
+void ppu_exec(ppu_t* ppu)
+{
+	if (ppu->scanlines < VISIBLE_SCANLINES) {
+		// render scanlines 0 - 239, a whole line at once unless
+		// ppu_flush already drew part of it.
+		if (ppu->dots == VISIBLE_DOTS)
+			render_span(ppu, VISIBLE_DOTS);
+
 		if (ppu->dots == VISIBLE_DOTS + 1 && ppu->mask & SHOW_BG) {
 			if ((ppu->v & FINE_Y) != FINE_Y) {
 				// increment coarse x
@@ -386,18 +404,21 @@ void ppu_exec(ppu_t* ppu)
 		else if (ppu->dots == VISIBLE_DOTS + 4 && ppu->mask & SHOW_SPRITE && ppu->mask & SHOW_BG) {
 			//ppu->mapper->on_scanline(ppu->mapper);
 		}
-		else if (ppu->dots == END_DOT && ppu->mask & RENDER_ENABLED) {
-			memset(ppu->oam_cache, 0, 8);
-			ppu->oam_cache_len = 0;
-			uint8_t range = ppu->ctrl & LONG_SPRITE ? 16: 8;
-			for(size_t i = ppu->oam_addr / 4; i < 64; i++) {
-				int diff = (int)ppu->scanlines - ppu->oam[i * 4];
-				if (diff >= 0 && diff < range) {
-					ppu->oam_cache[ppu->oam_cache_len++] = i * 4;
-					if (ppu->oam_cache_len >= 8)
-						break;
+		else if (ppu->dots == END_DOT) {
+			if (ppu->mask & RENDER_ENABLED) {
+				memset(ppu->oam_cache, 0, 8);
+				ppu->oam_cache_len = 0;
+				uint8_t range = ppu->ctrl & LONG_SPRITE ? 16: 8;
+				for(size_t i = ppu->oam_addr / 4; i < 64; i++) {
+					int diff = (int)ppu->scanlines - ppu->oam[i * 4];
+					if (diff >= 0 && diff < range) {
+						ppu->oam_cache[ppu->oam_cache_len++] = i * 4;
+						if (ppu->oam_cache_len >= 8)
+							break;
+					}
 				}
 			}
+			compose_sprites(ppu);
 		}
 	}
 	else if (ppu->scanlines == VISIBLE_SCANLINES) {
@@ -408,9 +429,9 @@ void ppu_exec(ppu_t* ppu)
 		if (ppu->dots == 1 && ppu->scanlines == VISIBLE_SCANLINES + 1) {
 			// set v-blank
 			ppu->status |= V_BLANK;
-			if (ppu->ctrl & GENERATE_NMI && ppu->bus->cpu) {
+			if (ppu->ctrl & GENERATE_NMI && ppu_bus(ppu)->cpu) {
 				// generate NMI
-				cpu_interrupt(ppu->bus->cpu, NMI);
+				cpu_interrupt(ppu_bus(ppu)->cpu, NMI);
 			}
 		}
 	}
@@ -419,6 +440,9 @@ void ppu_exec(ppu_t* ppu)
 		if (ppu->dots == 1) {
 			// reset v-blank and sprite zero hit
 			ppu->status &= ~(V_BLANK | SPRITE_0_HIT);
+
+			// no sprites are drawn on scanline 0
+			memset(ppu->sprite_line, 0, sizeof(ppu->sprite_line));
 		}
 		else if (ppu->dots == VISIBLE_DOTS + 2 && (ppu->mask & RENDER_ENABLED)) {
 			ppu->v &= ~HORIZONTAL_BITS;
@@ -431,7 +455,7 @@ void ppu_exec(ppu_t* ppu)
 			ppu->v &= ~VERTICAL_BITS;
 			ppu->v |= ppu->t & VERTICAL_BITS;
 		}
-		else if (ppu->dots == END_DOT - 1 && ppu->frames & 1 && ppu->mask & RENDER_ENABLED && ppu->bus->mapper->type == NTSC) {
+		else if (ppu->dots == END_DOT - 1 && ppu->frames & 1 && ppu->mask & RENDER_ENABLED && ppu_bus(ppu)->mapper->type == NTSC) {
 			// skip one cycle on odd frames if rendering is enabled for NTSC
 			ppu->dots++;
 		}
@@ -449,5 +473,133 @@ void ppu_exec(ppu_t* ppu)
 		if (ppu->scanlines++ >= ppu->scanlines_per_frame)
 			ppu->scanlines = 0;
 		ppu->dots = 0;
+		ppu->line_x = 0;
+	}
+}
+
+void ppu_run(ppu_t* ppu, size_t cycles)
+{
+	ppu->cycles += cycles;
+	while (cycles--) {
+		ppu_exec(ppu);
+		ppu_exec(ppu);
+		ppu_exec(ppu);
+		if (ppu->scanlines_per_frame == PAL_SCANLINES_PER_FRAME
+		    && ++ppu->pal_cycle == 5) {
+			// on the fifth cycle execute an extra ppu clock
+			// this produces 3.2 dots per cpu clock
+			ppu_exec(ppu);
+			ppu->pal_cycle = 0;
+		}
+	}
+}
+
+void ppu_sync(ppu_t* ppu, size_t cycle)
+{
+	// Stop once a frame is complete so that it can be presented
+	// before the next one starts drawing over it.
+	while (ppu->cycles < cycle && !ppu->render)
+		ppu_run(ppu, 1);
+}
+
+// dots_until returns the number of dots to execute until the given dot
+// of the given scanline has been executed.
+static size_t dots_until(ppu_t* ppu, size_t scanline, size_t dot)
+{
+	size_t frame = (size_t)(ppu->scanlines_per_frame + 1) * DOTS_PER_SCANLINE;
+	size_t now   = ppu->scanlines * DOTS_PER_SCANLINE + ppu->dots;
+	size_t then  = scanline * DOTS_PER_SCANLINE + dot;
+	return ((then >= now) ? then - now : then + frame - now) + 1;
+}
+
+size_t ppu_next_event(ppu_t* ppu)
+{
+	size_t vblank = dots_until(ppu, VISIBLE_SCANLINES + 1, 1);
+	size_t frame  = dots_until(ppu, ppu->scanlines_per_frame, END_DOT);
+	size_t dots   = (vblank < frame) ? vblank : frame;
+	size_t cycles;
+
+	// Leave a dot of slack for the skipped dot on odd NTSC frames,
+	// and for the extra dot every fifth CPU cycle on PAL.
+	if (ppu->scanlines_per_frame == PAL_SCANLINES_PER_FRAME)
+		cycles = (dots - 1) * 5 / 16;
+	else
+		cycles = (dots - 1) / 3;
+
+	return cycles ? cycles : 1;
+}
+
+#define PPU_STATE_VERSION 1
+
+void ppu_save(ppu_t* ppu, state_t* state)
+{
+	state_begin(state, "PPU ", PPU_STATE_VERSION);
+	state_write_u64(state, ppu->frames);
+	state_write(state, ppu->v_ram, sizeof(ppu->v_ram));
+	state_write(state, ppu->oam, sizeof(ppu->oam));
+	state_write(state, ppu->oam_cache, sizeof(ppu->oam_cache));
+	state_write(state, ppu->sprite_line, sizeof(ppu->sprite_line));
+	state_write(state, ppu->palette, sizeof(ppu->palette));
+	state_write_u8(state, ppu->oam_cache_len);
+	state_write_u8(state, ppu->ctrl);
+	state_write_u8(state, ppu->mask);
+	state_write_u8(state, ppu->status);
+	state_write_u16(state, ppu->dots);
+	state_write_u16(state, ppu->scanlines);
+	state_write_u16(state, ppu->line_x);
+	state_write_u16(state, ppu->v);
+	state_write_u16(state, ppu->t);
+	state_write_u8(state, ppu->x);
+	state_write_u8(state, ppu->w);
+	state_write_u8(state, ppu->oam_addr);
+	state_write_u8(state, ppu->buffer);
+	state_write_u8(state, ppu->render);
+	state_write_u8(state, ppu->ppu_bus);
+	state_write_u8(state, ppu->pal_cycle);
+	state_write_u64(state, ppu->cycles);
+	state_end(state);
+}
+
+int ppu_load(ppu_t* ppu, state_t* state)
+{
+	if (state_open(state, "PPU ", PPU_STATE_VERSION) < 0)
+		return -1;
+
+	ppu->frames = state_read_u64(state);
+	state_read(state, ppu->v_ram, sizeof(ppu->v_ram));
+	state_read(state, ppu->oam, sizeof(ppu->oam));
+	state_read(state, ppu->oam_cache, sizeof(ppu->oam_cache));
+	state_read(state, ppu->sprite_line, sizeof(ppu->sprite_line));
+	state_read(state, ppu->palette, sizeof(ppu->palette));
+	ppu->oam_cache_len = state_read_u8(state);
+	ppu->ctrl          = state_read_u8(state);
+	ppu->mask          = state_read_u8(state);
+	ppu->status        = state_read_u8(state);
+	ppu->dots          = state_read_u16(state);
+	ppu->scanlines     = state_read_u16(state);
+	ppu->line_x        = state_read_u16(state);
+	ppu->v             = state_read_u16(state);
+	ppu->t             = state_read_u16(state);
+	ppu->x             = state_read_u8(state);
+	ppu->w             = state_read_u8(state);
+	ppu->oam_addr      = state_read_u8(state);
+	ppu->buffer        = state_read_u8(state);
+	ppu->render        = state_read_u8(state);
+	ppu->ppu_bus       = state_read_u8(state);
+	ppu->pal_cycle     = state_read_u8(state);
+	ppu->cycles        = state_read_u64(state);
+
+	// The renderer indexes the frame, sprite_line and OAM with these,
+	// so a state from a damaged or crafted file must not take them out
+	// of range. scanlines reaches scanlines_per_frame on the pre-render
+	// line. Sprites are cached by the offset of their first byte.
+	if (ppu->oam_cache_len > sizeof(ppu->oam_cache) ||
+	    ppu->scanlines > ppu->scanlines_per_frame ||
+	    ppu->dots > END_DOT || ppu->line_x > VISIBLE_DOTS || ppu->x > 7)
+		return -1;
+	for (size_t i = 0; i < sizeof(ppu->oam_cache); i++) {
+		if (ppu->oam_cache[i] % 4 || ppu->oam_cache[i] > 252)
+			return -1;
 	}
+	return state->error ? -1 : 0;
 }
@@ -3,6 +3,7 @@
 
 #include "system.h"
 #include "bus.h"
+#include "state.h"
 
 #define VISIBLE_SCANLINES        240
 #define VISIBLE_DOTS             256
@@ -11,10 +12,15 @@
 #define DOTS_PER_SCANLINE        341
 #define END_DOT                  340
 
+// Flags stored in sprite_line entries above the sprite's palette address.
+#define SPRITE_BEHIND_BG         0x20
+#define SPRITE_ZERO              0x40
+
 enum
 {
 	BG_TABLE        = 1 << 4,
 	SPRITE_TABLE    = 1 << 3,
+	GREYSCALE       = 1 << 0,
 	SHOW_BG_8       = 1 << 1,
 	SHOW_SPRITE_8   = 1 << 2,
 	SHOW_BG         = 1 << 3,
@@ -40,10 +46,11 @@ enum
 typedef struct ppu_t
 {
 	size_t frames;
-	uint32_t* screen;
+
 	uint8_t v_ram[0x1000];
 	uint8_t oam[256];
 	uint8_t oam_cache[8];
+	uint8_t sprite_line[VISIBLE_DOTS];
 	uint8_t palette[0x20];
 	uint8_t oam_cache_len;
 	uint8_t ctrl;
@@ -53,6 +60,9 @@ typedef struct ppu_t
 	size_t scanlines;
 	uint16_t scanlines_per_frame;
 
+	// Next pixel of the current scanline to be drawn.
+	uint16_t line_x;
+
 	uint16_t v;
 	uint16_t t;
 	uint8_t x;
@@ -62,36 +72,16 @@ typedef struct ppu_t
 
 	uint8_t render;
 	uint8_t ppu_bus;
+	uint8_t pal_cycle;
 
-	bus_t* bus;
+	// CPU cycles the PPU has been clocked for by ppu_run.
+	size_t cycles;
 
 } ppu_t;
 
-// ARGB8888 palette
-static const uint32_t ppu_palette_raw[64] =
-{
-	0xff666666, 0xff002a88, 0xff1412a7, 0xff3b00a4,
-	0xff5c007e, 0xff6e0040, 0xff6c0600, 0xff561d00,
-	0xff333500, 0xff0b4800, 0xff005200, 0xff004f08,
-	0xff00404d, 0xff000000, 0xff000000, 0xff000000,
-	0xffadadad, 0xff155fd9, 0xff4240ff, 0xff7527fe,
-	0xffa01acc, 0xffb71e7b, 0xffb53120, 0xff994e00,
-	0xff6b6d00, 0xff388700, 0xff0c9300, 0xff008f32,
-	0xff007c8d, 0xff000000, 0xff000000, 0xff000000,
-	0xfffffeff, 0xff64b0ff, 0xff9290ff, 0xffc676ff,
-	0xfff36aff, 0xfffe6ecc, 0xfffe8170, 0xffea9e22,
-	0xffbcbe00, 0xff88d800, 0xff5ce430, 0xff45e082,
-	0xff48cdde, 0xff4f4f4f, 0xff000000, 0xff000000,
-	0xfffffeff, 0xffc0dfff, 0xffd3d2ff, 0xffe8c8ff,
-	0xfffbc2ff, 0xfffec4ea, 0xfffeccc5, 0xfff7d8a5,
-	0xffe4e594, 0xffcfef96, 0xffbdf4ab, 0xffb3f3cc,
-	0xffb5ebf2, 0xffb8b8b8, 0xff000000, 0xff000000,
-};
-
-extern uint32_t ppu_palette[64];
-
-ppu_t* ppu_create(bus_t* bus);
-void ppu_destroy(ppu_t* ppu);
+// ppu_init powers on the PPU of a machine (see machine.h), whose bus
+// must already be set up.
+void ppu_init(ppu_t* ppu);
 
 // ppu_reset performs a soft reset on the ppu.
 void ppu_reset(ppu_t* ppu);
@@ -99,6 +89,25 @@ void ppu_reset(ppu_t* ppu);
 // ppu_exec executes a single PPU cycle.
 void ppu_exec(ppu_t* ppu);
 
+// ppu_run executes the PPU cycles that elapse during the given number
+// of CPU cycles (3 per CPU cycle on NTSC, 3.2 on PAL).
+void ppu_run(ppu_t* ppu, size_t cycles);
+
+// ppu_sync runs the PPU until it has caught up with the given CPU
+// cycle (as counted by ppu_run), or until it completes a frame.
+void ppu_sync(ppu_t* ppu, size_t cycle);
+
+// ppu_next_event returns a lower bound on the number of CPU cycles
+// until the PPU raises vblank (and NMI) or completes a frame. The
+// result is at least 1.
+size_t ppu_next_event(ppu_t* ppu);
+
+// ppu_flush draws the pixels of the current scanline up to the current
+// dot. It must be called before anything that affects rendering (PPU
+// registers, OAM) changes mid-scanline; the rest of the line is drawn
+// at once on its last visible dot.
+void ppu_flush(ppu_t* ppu);
+
 // ppu_read_status emulates reading from PPU_STATUS (0x2003).
 uint8_t ppu_read_status(ppu_t* ppu);
 
@@ -135,4 +144,10 @@ uint8_t ppu_read_vram(ppu_t* ppu, uint16_t addr);
 // ppu_read_vram writes to the PPU's internal video memory.
 void ppu_write_vram(ppu_t* ppu, uint16_t addr, uint8_t val);
 
+// ppu_save writes the PPU's state to a "PPU " chunk, and ppu_load reads
+// it back. ppu_load returns 0 on success. The frame being drawn is not
+// part of the state, so states are best taken between frames.
+void ppu_save(ppu_t* ppu, state_t* state);
+int ppu_load(ppu_t* ppu, state_t* state);
+
 #endif // NES_TOOLS_PPU_H
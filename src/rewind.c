@@ -0,0 +1,152 @@
+#include "rewind.h"
+#include "delta.h"
+
+static rewind_entry_t* entry(rewind_t* rewind, size_t index)
+{ return &rewind->entries[(rewind->first + index) % rewind->cap]; }
+
+static void drop_oldest(rewind_t* rewind)
+{
+	rewind->used -= entry(rewind, 0)->len;
+	rewind->first = (rewind->first + 1) % rewind->cap;
+	rewind->count--;
+}
+
+// overlaps reports whether e intersects [offset, offset + len).
+static uint8_t overlaps(const rewind_entry_t* e, size_t offset, size_t len)
+{ return e->offset < offset + len && offset < e->offset + e->len; }
+
+// push stores an encoded state after the newest one, dropping the
+// oldest ones to make room.
+static void push(rewind_t* rewind, const uint8_t* delta, size_t len)
+{
+	if (len > rewind->size) {
+		while (rewind->count)
+			drop_oldest(rewind);
+		return;
+	}
+
+	if (rewind->count == rewind->cap) {
+		size_t cap = rewind->cap * 2;
+		rewind_entry_t* entries = malloc(sizeof(rewind_entry_t) * cap);
+		if (entries == NULL) {
+			drop_oldest(rewind);
+		} else {
+			for (size_t i = 0; i < rewind->count; i++)
+				entries[i] = *entry(rewind, i);
+			free(rewind->entries);
+			rewind->entries = entries;
+			rewind->cap     = cap;
+			rewind->first   = 0;
+		}
+	}
+
+	// States are stored one after another, wrapping to the start of
+	// the ring once the next one does not fit before its end. The
+	// space taken over (including the end of the ring skipped when
+	// wrapping) is that of the oldest states.
+	size_t end = 0;
+	if (rewind->count) {
+		rewind_entry_t* newest = entry(rewind, rewind->count - 1);
+		end = newest->offset + newest->len;
+	}
+
+	size_t offset = (end + len > rewind->size) ? 0 : end;
+	while (rewind->count) {
+		rewind_entry_t* oldest = entry(rewind, 0);
+		if (!overlaps(oldest, offset, len) &&
+		    !(offset == 0 && overlaps(oldest, end, rewind->size - end)))
+			break;
+		drop_oldest(rewind);
+	}
+
+	memcpy(rewind->data + offset, delta, len);
+	*entry(rewind, rewind->count++) = (rewind_entry_t){offset, len};
+	rewind->used += len;
+}
+
+rewind_t* rewind_create(machine_t* machine, size_t budget, unsigned interval)
+{
+	rewind_t* rewind = malloc(sizeof(rewind_t));
+	if (rewind == NULL) {
+		LOG(ERROR, "Failed to allocate rewind history");
+		return NULL;
+	}
+	memset(rewind, 0, sizeof(rewind_t));
+
+	rewind->machine    = machine;
+	rewind->state_size = machine_state_size(machine);
+	rewind->size       = budget;
+	rewind->cap        = 256;
+	rewind->interval   = interval ? interval : 1;
+	rewind->frames     = rewind->interval - 1;
+
+	rewind->state   = malloc(rewind->state_size);
+	rewind->next    = malloc(rewind->state_size);
+	rewind->delta   = malloc(DELTA_MAX_SIZE(rewind->state_size));
+	rewind->data    = malloc(budget);
+	rewind->entries = malloc(sizeof(rewind_entry_t) * rewind->cap);
+
+	if (!rewind->state || !rewind->next || !rewind->delta ||
+	    !rewind->data || !rewind->entries) {
+		LOG(ERROR, "Failed to allocate rewind history");
+		rewind_destroy(rewind);
+		return NULL;
+	}
+	return rewind;
+}
+
+void rewind_destroy(rewind_t* rewind)
+{
+	free(rewind->state);
+	free(rewind->next);
+	free(rewind->delta);
+	free(rewind->data);
+	free(rewind->entries);
+	free(rewind);
+}
+
+void rewind_capture(rewind_t* rewind)
+{
+	if (++rewind->frames < rewind->interval)
+		return;
+	rewind->frames = 0;
+
+	machine_save(rewind->machine, rewind->next);
+	if (rewind->recorded) {
+		size_t len = delta_encode(rewind->state, rewind->next,
+			rewind->state_size, rewind->delta);
+		push(rewind, rewind->delta, len);
+	}
+
+	uint8_t* state = rewind->state;
+	rewind->state    = rewind->next;
+	rewind->next     = state;
+	rewind->recorded = 1;
+	rewind->stepped  = 0;
+}
+
+int rewind_step(rewind_t* rewind)
+{
+	if (!rewind->recorded)
+		return -1;
+
+	int err = 0;
+	if (rewind->stepped) {
+		if (rewind->count) {
+			rewind_entry_t* newest = entry(rewind, --rewind->count);
+			delta_apply(rewind->state, rewind->state_size,
+				rewind->data + newest->offset, newest->len);
+			rewind->used -= newest->len;
+		} else {
+			err = -1;
+		}
+	}
+
+	machine_restore(rewind->machine, rewind->state);
+	rewind->stepped = 1;
+	rewind->frames  = 0;
+	return err;
+}
+
+size_t rewind_frames(rewind_t* rewind)
+{ return rewind->recorded ? rewind->count * rewind->interval : 0; }
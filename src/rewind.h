@@ -0,0 +1,75 @@
+#ifndef NES_TOOLS_REWIND_H
+#define NES_TOOLS_REWIND_H
+
+#include "system.h"
+#include "machine.h"
+
+// Default and largest memory budget of the rewind history in MB, and the
+// number of frames between the states it records.
+#define REWIND_BUDGET     64
+#define MAX_REWIND_BUDGET 1024
+#define REWIND_INTERVAL   2
+
+// rewind_entry_t locates one encoded state in rewind_t.data.
+typedef struct
+{
+	size_t offset;
+	size_t len;
+
+} rewind_entry_t;
+
+// rewind_t is a history of a machine's states that can be stepped back
+// through. The newest recorded state is kept whole. Every older one is
+// kept as its XOR with the state after it, which is mostly zeros, with
+// the zero runs encoded as counts (see delta.h). The encoded states are stored in a
+// ring of a fixed size; once it is full, the oldest are dropped.
+typedef struct
+{
+	machine_t* machine;
+	size_t     state_size;
+
+	// The newest recorded state, and a buffer for the next one.
+	uint8_t* state;
+	uint8_t* next;
+	uint8_t  recorded;
+
+	// Set once the machine has been restored to state, so that the
+	// next step goes further back.
+	uint8_t stepped;
+
+	// Encoded states, oldest first. entries is a ring of cap entries
+	// starting at first.
+	uint8_t*        data;
+	size_t          size;
+	size_t          used;
+	rewind_entry_t* entries;
+	size_t          cap;
+	size_t          first;
+	size_t          count;
+
+	// Buffer for encoding a state.
+	uint8_t* delta;
+
+	unsigned interval;
+	unsigned frames;
+
+} rewind_t;
+
+// rewind_create allocates a history for machine that records a state
+// every interval frames, in at most budget bytes.
+rewind_t* rewind_create(machine_t* machine, size_t budget, unsigned interval);
+void rewind_destroy(rewind_t* rewind);
+
+// rewind_capture is called after every frame; every interval frames
+// it records the machine's state.
+void rewind_capture(rewind_t* rewind);
+
+// rewind_step restores the machine to the newest recorded state, or
+// to the one before it if the machine was just restored to it. It
+// returns 0, or -1 once the oldest state has been reached.
+int rewind_step(rewind_t* rewind);
+
+// rewind_frames returns the number of frames the history spans.
+size_t rewind_frames(rewind_t* rewind);
+
+#endif // NES_TOOLS_REWIND_H
@@ -1,95 +1,89 @@
 #include "snapshot.h"
 
-snapshot_t* snapshot_create(emulator_t* emu)
-{
-	snapshot_t* snap = malloc(sizeof(snapshot_t));
-
-	snap->cpu    = malloc(sizeof(cpu6502_t));
-	snap->ppu    = malloc(sizeof(ppu_t));
-	snap->apu    = malloc(sizeof(apu_t));
-	snap->bus    = malloc(sizeof(bus_t));
-	snap->mapper = malloc(sizeof(mapper_t));
+int snapshot_save(emulator_t* emu, state_t* state)
+{ return machine_serialize(emu->machine, state); }
 
-	snapshot_update(snap, emu);
-
-	return snap;
+// load reads every component's chunk into the emulator, stopping at
+// the first that cannot be read.
+static int load(emulator_t* emu, state_t* state)
+{
+	if (state_check(state) || mapper_load(emu->mapper, state) ||
+	    cpu_load(emu->cpu, state) || ppu_load(emu->ppu, state) ||
+	    apu_load(emu->apu, state) || bus_load(emu->bus, state))
+		return -1;
+	return 0;
 }
 
-void snapshot_update(snapshot_t* snap, emulator_t* emu)
+int snapshot_load(emulator_t* emu, state_t* state)
 {
-	memcpy(snap->cpu, emu->cpu, sizeof(cpu6502_t));
-	memcpy(snap->ppu, emu->ppu, sizeof(ppu_t));
-	memcpy(snap->apu, emu->apu, sizeof(apu_t));
-	memcpy(snap->bus, emu->bus, sizeof(bus_t));
-	memcpy(snap->mapper, emu->bus->mapper, sizeof(mapper_t));
-
-	// Update bus addresses.
-	snap->cpu->bus = snap->bus;
-	snap->ppu->bus = snap->bus;
-	snap->apu->bus = snap->bus;
-
-	// Update bus.
-	bus_set_cpu(snap->bus, snap->cpu);
-	bus_set_ppu(snap->bus, snap->ppu);
-	bus_set_apu(snap->bus, snap->apu);
-
-	// Update mapper.
-	uint8_t chr_banks = snap->mapper->chr_banks;
-	uint8_t prg_banks = snap->mapper->prg_banks;
-	uint8_t ram_size = snap->mapper->ram_size;
-
-	snap->chr_rom = malloc(0x2000 * chr_banks);
-	snap->prg_rom = malloc(0x4000 * prg_banks);
-	snap->prg_ram = malloc(ram_size);
-
-	memcpy(snap->chr_rom, emu->mapper->chr_rom, 0x2000 * chr_banks);
-	memcpy(snap->prg_rom, emu->mapper->prg_rom, 0x2000 * prg_banks);
-	memcpy(snap->prg_ram, emu->mapper->prg_ram, ram_size);
-
-	// Update joypad, otherwise keys get stuck.
-	snap->bus->joy1.status = 0;
-	snap->bus->joy2.status = 0;
+	// A state can be found to be bad half way through loading it, so
+	// keep the current one to fall back to.
+	state_t backup;
+	state_init(&backup);
+	if (snapshot_save(emu, &backup)) {
+		state_free(&backup);
+		return -1;
+	}
+
+	int err = load(emu, state);
+	if (err) {
+		LOG(ERROR, "Failed to load save state");
+		load(emu, &backup);
+	}
+
+	state_free(&backup);
+	return err;
 }
 
-void snapshot_destroy(snapshot_t* snap)
+// slot_path writes the path of the given slot's file to path.
+static int slot_path(emulator_t* emu, int slot, char* path, size_t size)
 {
-	free(snap->cpu);
-	free(snap->ppu);
-	free(snap->apu);
-	free(snap->bus);
-	free(snap->mapper);
-	free(snap->chr_rom);
-	free(snap->prg_rom);
-	free(snap->prg_ram);
-	free(snap);
+	if (emu->path == NULL || slot < 0 || slot >= SNAPSHOT_SLOTS) {
+		LOG(ERROR, "No save state slot %d", slot);
+		return -1;
+	}
+
+	// Replace the ROM's extension, if it has one.
+	const char* ext = strrchr(emu->path, '.');
+	const char* dir = strrchr(emu->path, '/');
+	int len = (ext && (!dir || ext > dir)) ?
+		(int)(ext - emu->path) : (int)strlen(emu->path);
+
+	if (snprintf(path, size, "%.*s.ss%d", len, emu->path, slot) >= (int)size) {
+		LOG(ERROR, "Save state path too long");
+		return -1;
+	}
+	return 0;
 }
 
-void snapshot_restore(snapshot_t* snap, emulator_t* emu)
+int snapshot_save_slot(emulator_t* emu, int slot)
 {
-	memcpy(emu->cpu, snap->cpu, sizeof(cpu6502_t));
-	memcpy(emu->ppu, snap->ppu, sizeof(ppu_t));
-	memcpy(emu->apu, snap->apu, sizeof(apu_t));
-	memcpy(emu->bus, snap->bus, sizeof(bus_t));
-	memcpy(emu->bus->mapper, snap->mapper, sizeof(mapper_t));
-
-	// Update bus addresses.
-	emu->cpu->bus = emu->bus;
-	emu->ppu->bus = emu->bus;
-	emu->apu->bus = emu->bus;
-
-	// Update bus internals.
-	bus_set_cpu(emu->bus, emu->cpu);
-	bus_set_ppu(emu->bus, emu->ppu);
-	bus_set_apu(emu->bus, emu->apu);
-
-	// Update mapper.
-	uint8_t chr_banks = snap->mapper->chr_banks;
-	uint8_t prg_banks = snap->mapper->prg_banks;
-	uint8_t ram_size = snap->mapper->ram_size;
-
-	memcpy(emu->bus->mapper->chr_rom, snap->chr_rom, 0x2000 * chr_banks);
-	memcpy(emu->bus->mapper->prg_rom, snap->prg_rom, 0x2000 * prg_banks);
-	memcpy(emu->bus->mapper->prg_ram, snap->prg_ram, ram_size);
+	char path[FILENAME_MAX];
+	if (slot_path(emu, slot, path, sizeof(path)))
+		return -1;
+
+	state_t state;
+	state_init(&state);
+	int err = snapshot_save(emu, &state) || state_save_file(&state, path);
+	state_free(&state);
+
+	if (!err)
+		LOG(INFO, "Saved state to %s", path);
+	return err;
+}
 
-	SDL_RenderClear(emu->gfx->renderer);
+int snapshot_load_slot(emulator_t* emu, int slot)
+{
+	char path[FILENAME_MAX];
+	if (slot_path(emu, slot, path, sizeof(path)))
+		return -1;
+
+	state_t state;
+	state_init(&state);
+	int err = state_load_file(&state, path) || snapshot_load(emu, &state);
+	state_free(&state);
+
+	if (!err)
+		LOG(INFO, "Loaded state from %s", path);
+	return err ? -1 : 0;
 }
@@ -2,35 +2,27 @@
 #define NES_TOOLS_SNAPSHOT_H
 
 #include "system.h"
+#include "state.h"
 #include "emulator.h"
 
-// snapshot_t stores the emulator's state at a some point in time.
-typedef struct
-{
-	cpu6502_t* cpu;
-	ppu_t*     ppu;
-	apu_t*     apu;
-	bus_t*     bus;
-
-	mapper_t*  mapper;
-
-	uint8_t* chr_rom;
-	uint8_t* prg_rom;
-	uint8_t* prg_ram;
-
-} snapshot_t;
-
-// snapshot_create copies the emulator's state into a new snapshot_t.
-snapshot_t* snapshot_create(emulator_t* emu);
-
-// snapshot_update copies an emulator's state into an already
-// initialized snapshot_t struct.
-void snapshot_update(snapshot_t* snap, emulator_t* emu);
-
-// snapshot_restore writes the snapshot's state into the given emulator.
-void snapshot_restore(snapshot_t* snap, emulator_t* emu);
-
-// snapshot_destroy safely deallocates a snapshot_t instance.
-void snapshot_destroy(snapshot_t* snap);
+// Number of save state slots. Slot n of "game.nes" is stored in
+// "game.ssn", next to the ROM.
+#define SNAPSHOT_SLOTS 10
+
+// snapshot_save writes the state of every component of the emulator
+// into state, replacing its contents. It returns 0 on success, or -1
+// if memory ran out.
+int snapshot_save(emulator_t* emu, state_t* state);
+
+// snapshot_load restores the emulator's state from state. It returns
+// 0 on success; otherwise the emulator is left as it was, and -1 is
+// returned.
+int snapshot_load(emulator_t* emu, state_t* state);
+
+// snapshot_save_slot and snapshot_load_slot save the emulator's state
+// to, and restore it from, the given slot's file. They return 0 on
+// success.
+int snapshot_save_slot(emulator_t* emu, int slot);
+int snapshot_load_slot(emulator_t* emu, int slot);
 
 #endif // NES_TOOLS_SNAPSHOT_H
@@ -0,0 +1,236 @@
+#include "state.h"
+
+#define HEADER_SIZE 6
+#define CHUNK_HEADER_SIZE 10
+
+// reserve makes room for len more bytes. It returns -1, and sets
+// state->error, if the buffer cannot grow.
+static int reserve(state_t* state, size_t len)
+{
+	if (state->error)
+		return -1;
+	if (state->len + len <= state->cap)
+		return 0;
+
+	size_t cap = state->cap ? state->cap : 0x1000;
+	while (cap < state->len + len)
+		cap *= 2;
+
+	uint8_t* data = realloc(state->data, cap);
+	if (data == NULL) {
+		LOG(ERROR, "Failed to allocate save state buffer");
+		state->error = 1;
+		return -1;
+	}
+	state->data = data;
+	state->cap  = cap;
+	return 0;
+}
+
+static void put(uint8_t* out, uint64_t val, int bytes)
+{
+	for (int i = 0; i < bytes; i++)
+		out[i] = val >> (8 * i);
+}
+
+static uint64_t get(const uint8_t* in, int bytes)
+{
+	uint64_t val = 0;
+	for (int i = 0; i < bytes; i++)
+		val |= (uint64_t)in[i] << (8 * i);
+	return val;
+}
+
+void state_init(state_t* state)
+{ memset(state, 0, sizeof(state_t)); }
+
+void state_free(state_t* state)
+{
+	free(state->data);
+	state_init(state);
+}
+
+void state_reset(state_t* state)
+{
+	state->len   = 0;
+	state->pos   = 0;
+	state->end   = 0;
+	state->error = 0;
+
+	if (reserve(state, HEADER_SIZE))
+		return;
+	memcpy(state->data, STATE_MAGIC, 4);
+	put(state->data + 4, STATE_VERSION, 2);
+	state->len = HEADER_SIZE;
+}
+
+int state_check(state_t* state)
+{
+	if (state->len < HEADER_SIZE || memcmp(state->data, STATE_MAGIC, 4)) {
+		LOG(ERROR, "Not a save state");
+		return -1;
+	}
+
+	uint16_t version = get(state->data + 4, 2);
+	if (version != STATE_VERSION) {
+		LOG(ERROR, "Unsupported save state version %u", version);
+		return -1;
+	}
+	return 0;
+}
+
+int state_save_file(state_t* state, const char* path)
+{
+	char tmp[FILENAME_MAX];
+	if (snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int)sizeof(tmp)) {
+		LOG(ERROR, "Save state path too long: %s", path);
+		return -1;
+	}
+
+	FILE* file = fopen(tmp, "wb");
+	if (file == NULL) {
+		LOG(ERROR, "Failed to open %s", tmp);
+		return -1;
+	}
+
+	size_t written = fwrite(state->data, 1, state->len, file);
+	if (fclose(file) || written != state->len || rename(tmp, path)) {
+		LOG(ERROR, "Failed to write %s", path);
+		remove(tmp);
+		return -1;
+	}
+	return 0;
+}
+
+int state_load_file(state_t* state, const char* path)
+{
+	FILE* file = fopen(path, "rb");
+	if (file == NULL) {
+		LOG(ERROR, "Failed to open %s", path);
+		return -1;
+	}
+
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	state->len   = 0;
+	state->error = 0;
+	if (size < 0 || reserve(state, size) ||
+	    fread(state->data, 1, size, file) != (size_t)size) {
+		LOG(ERROR, "Failed to read %s", path);
+		fclose(file);
+		return -1;
+	}
+	fclose(file);
+
+	state->len = size;
+	state->pos = 0;
+	state->end = 0;
+	return 0;
+}
+
+void state_begin(state_t* state, const char* tag, uint16_t version)
+{
+	if (reserve(state, CHUNK_HEADER_SIZE))
+		return;
+	state->chunk = state->len;
+
+	uint8_t* header = state->data + state->len;
+	memcpy(header, tag, 4);
+	put(header + 4, version, 2);
+	state->len += CHUNK_HEADER_SIZE;
+}
+
+void state_end(state_t* state)
+{
+	if (state->error)
+		return;
+	size_t body = state->len - state->chunk - CHUNK_HEADER_SIZE;
+	put(state->data + state->chunk + 6, body, 4);
+}
+
+void state_write(state_t* state, const void* data, size_t len)
+{
+	if (reserve(state, len))
+		return;
+	memcpy(state->data + state->len, data, len);
+	state->len += len;
+}
+
+static void write_int(state_t* state, uint64_t val, int bytes)
+{
+	if (reserve(state, bytes))
+		return;
+	put(state->data + state->len, val, bytes);
+	state->len += bytes;
+}
+
+void state_write_u8(state_t* state, uint8_t val)
+{ write_int(state, val, 1); }
+
+void state_write_u16(state_t* state, uint16_t val)
+{ write_int(state, val, 2); }
+
+void state_write_u32(state_t* state, uint32_t val)
+{ write_int(state, val, 4); }
+
+void state_write_u64(state_t* state, uint64_t val)
+{ write_int(state, val, 8); }
+
+int state_open(state_t* state, const char* tag, uint16_t version)
+{
+	size_t pos = HEADER_SIZE;
+	while (pos + CHUNK_HEADER_SIZE <= state->len) {
+		const uint8_t* header = state->data + pos;
+		size_t body = get(header + 6, 4);
+		if (body > state->len - pos - CHUNK_HEADER_SIZE)
+			break;
+
+		if (!memcmp(header, tag, 4)) {
+			uint16_t found = get(header + 4, 2);
+			if (found > version) {
+				LOG(ERROR, "Unsupported '%.4s' chunk version %u", tag, found);
+				return -1;
+			}
+			state->pos = pos + CHUNK_HEADER_SIZE;
+			state->end = state->pos + body;
+			return found;
+		}
+		pos += CHUNK_HEADER_SIZE + body;
+	}
+
+	LOG(ERROR, "Save state has no '%.4s' chunk", tag);
+	return -1;
+}
+
+void state_read(state_t* state, void* data, size_t len)
+{
+	if (len > state->end - state->pos) {
+		memset(data, 0, len);
+		state->pos   = state->end;
+		state->error = 1;
+		return;
+	}
+	memcpy(data, state->data + state->pos, len);
+	state->pos += len;
+}
+
+static uint64_t read_int(state_t* state, int bytes)
+{
+	uint8_t in[8];
+	state_read(state, in, bytes);
+	return get(in, bytes);
+}
+
+uint8_t state_read_u8(state_t* state)
+{ return read_int(state, 1); }
+
+uint16_t state_read_u16(state_t* state)
+{ return read_int(state, 2); }
+
+uint32_t state_read_u32(state_t* state)
+{ return read_int(state, 4); }
+
+uint64_t state_read_u64(state_t* state)
+{ return read_int(state, 8); }
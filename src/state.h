@@ -0,0 +1,82 @@
+#ifndef NES_TOOLS_STATE_H
+#define NES_TOOLS_STATE_H
+
+#include "system.h"
+
+// A save state is a short header (STATE_MAGIC and STATE_VERSION)
+// followed by chunks. Each chunk holds the state of one component: a
+// 4-character tag, the version of the chunk's layout, the length of
+// its body and the body itself. Integers are stored little-endian.
+// Readers skip chunks they do not know, so components can be added
+// without breaking existing states.
+
+#define STATE_MAGIC   "NESS"
+#define STATE_VERSION 1
+
+// state_t is a buffer that save states are written to and read from.
+typedef struct
+{
+	uint8_t* data;
+	size_t   len;
+	size_t   cap;
+
+	// Writing: offset of the open chunk.
+	size_t   chunk;
+
+	// Reading: position in, and end of, the open chunk. error is set
+	// once a read runs past the end of the chunk, or once the buffer
+	// cannot grow for a write; later writes are then dropped.
+	size_t   pos;
+	size_t   end;
+	uint8_t  error;
+
+} state_t;
+
+// state_init initializes an empty state_t, and state_free releases
+// its buffer.
+void state_init(state_t* state);
+void state_free(state_t* state);
+
+// state_reset empties the state and writes the header, ready for
+// chunks to be added.
+void state_reset(state_t* state);
+
+// state_check verifies the state's header. It returns 0 if the state
+// can be read, or -1.
+int state_check(state_t* state);
+
+// state_save_file writes the state to path, replacing any previous
+// file only once the new one is complete. It returns 0 on success.
+int state_save_file(state_t* state, const char* path);
+
+// state_load_file replaces the state with the contents of the file at
+// path. It returns 0 on success.
+int state_load_file(state_t* state, const char* path);
+
+// state_begin opens a chunk with the given tag and layout version,
+// and state_end closes it. Chunks cannot be nested.
+void state_begin(state_t* state, const char* tag, uint16_t version);
+void state_end(state_t* state);
+
+// state_write appends len bytes to the open chunk. If memory runs
+// out, it sets state->error instead.
+void state_write(state_t* state, const void* data, size_t len);
+void state_write_u8(state_t* state, uint8_t val);
+void state_write_u16(state_t* state, uint16_t val);
+void state_write_u32(state_t* state, uint32_t val);
+void state_write_u64(state_t* state, uint64_t val);
+
+// state_open opens the chunk with the given tag for reading. It
+// returns the chunk's layout version, or -1 if there is no such chunk
+// or its version is newer than the given one.
+int state_open(state_t* state, const char* tag, uint16_t version);
+
+// state_read reads len bytes from the open chunk. Reads past the end
+// of the chunk yield zeros and set state->error.
+void state_read(state_t* state, void* data, size_t len);
+uint8_t state_read_u8(state_t* state);
+uint16_t state_read_u16(state_t* state);
+uint32_t state_read_u32(state_t* state);
+uint64_t state_read_u64(state_t* state);
+
+#endif // NES_TOOLS_STATE_H
@@ -3,17 +3,12 @@
 
 #include "config.h"
 
-#if defined _WIN32 || defined __CYGWIN__
-#define SDL_MAIN_HANDLED
-#endif
-
-#include <SDL.h>
-#include <SDL_ttf.h>
-
 #include <time.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <math.h>
 #include "log.h"
 
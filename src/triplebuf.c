@@ -0,0 +1,41 @@
+#include "triplebuf.h"
+
+triplebuf_t* triplebuf_create(void)
+{
+	triplebuf_t* buf = malloc(sizeof(triplebuf_t));
+	if (buf == NULL) {
+		LOG(ERROR, "Failed to allocate frame buffers");
+		return NULL;
+	}
+
+	memset(buf->frames, 0, sizeof(buf->frames));
+	buf->back  = 0;
+	buf->front = 1;
+	atomic_init(&buf->middle, 2);
+
+	return buf;
+}
+
+void triplebuf_destroy(triplebuf_t* buf)
+{ free(buf); }
+
+void triplebuf_publish(triplebuf_t* buf)
+{
+	// Release the frame's contents along with the index.
+	unsigned prev = atomic_exchange_explicit(&buf->middle,
+		buf->back | TRIPLEBUF_FRESH, memory_order_acq_rel);
+
+	buf->back = prev & 3;
+}
+
+const frame_t* triplebuf_latest(triplebuf_t* buf)
+{
+	if (!(atomic_load_explicit(&buf->middle, memory_order_relaxed) & TRIPLEBUF_FRESH))
+		return NULL;
+
+	unsigned prev = atomic_exchange_explicit(&buf->middle,
+		buf->front, memory_order_acq_rel);
+
+	buf->front = prev & 3;
+	return &buf->frames[buf->front];
+}
@@ -0,0 +1,54 @@
+#ifndef NES_TOOLS_TRIPLEBUF_H
+#define NES_TOOLS_TRIPLEBUF_H
+
+#include <stdatomic.h>
+
+#include "system.h"
+#include "ppu.h"
+
+// Set in triplebuf_t.middle when the middle buffer holds a frame the
+// consumer has not taken yet.
+#define TRIPLEBUF_FRESH 0x4
+
+// frame_t is a completed, indexed PPU frame (see palette.h).
+typedef struct
+{
+	uint8_t screen[VISIBLE_SCANLINES * VISIBLE_DOTS];
+	uint8_t emphasis[VISIBLE_SCANLINES];
+
+} frame_t;
+
+// triplebuf_t hands frames from one producer thread to one consumer
+// thread without locks. The producer always owns the back buffer and
+// the consumer the front buffer; completed frames are swapped through
+// the middle one, so neither side ever waits and the consumer always
+// gets the newest frame (older unseen frames are dropped).
+typedef struct
+{
+	frame_t frames[3];
+	uint8_t back;
+	uint8_t front;
+
+	// Index of the middle buffer, plus TRIPLEBUF_FRESH.
+	atomic_uint middle;
+
+} triplebuf_t;
+
+// triplebuf_create allocates a new triplebuf_t.
+triplebuf_t* triplebuf_create(void);
+void triplebuf_destroy(triplebuf_t* buf);
+
+// triplebuf_back returns the buffer the producer should fill next.
+static inline frame_t* triplebuf_back(triplebuf_t* buf)
+{ return &buf->frames[buf->back]; }
+
+// triplebuf_publish makes the back buffer the newest frame, and gives
+// the producer a new back buffer.
+void triplebuf_publish(triplebuf_t* buf);
+
+// triplebuf_latest returns the newest frame published since the last
+// call, or NULL if there is none. The frame stays valid until the next
+// call.
+const frame_t* triplebuf_latest(triplebuf_t* buf);
+
+#endif // NES_TOOLS_TRIPLEBUF_H